@@ -3,825 +3,5222 @@
 #include <string.h>
 #include <semaphore.h>
 #include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <signal.h>
 
 // Define constants
-#define MEMORY_SIZE 60
-#define MAX_PROGRAMS 3
+#define DEFAULT_MEMORY_SIZE 60
+#define INTERACTIVE_PROGRAMS 3
 #define INPUT_SPACE_PER_PROCESS 3
 #define MAX_LINES 100
 #define MAX_LINE_LENGTH 256
-// Mutexes for resource access control
+#define MAX_VALUE_LENGTH 255
+#define TRACE_BUFFER_SIZE (1 << 20)
+#define MLFQ_LEVELS 3
+#define MLFQ_BOOST_INTERVAL 50
+#define PRIORITY_LEVELS 10
+// Semaphores guarding the real file and console I/O
 sem_t file_mutex, input_mutex, output_mutex;
 
+// How executed instructions are paced against the wall clock
+enum PacingMode {
+    PACE_MAX,    // unthrottled
+    PACE_SCALED, // one tick every tick_length_us microseconds
+    PACE_DEMO    // one tick per second
+};
+
+// How much of the simulation is traced on stdout; program output is always printed
+enum TraceLevel {
+    TRACE_SILENT,  // nothing
+    TRACE_SUMMARY, // warnings and end-of-run statistics
+    TRACE_EVENT,   // one line per scheduling event and instruction, plus changed memory words and queues
+    TRACE_FULL     // full memory and queue dumps after every instruction
+};
+
+#define TRACE(level, ...) do { if (trace_level >= (level)) printf(__VA_ARGS__); } while (0)
+
+// Simulator settings
+enum TraceLevel trace_level = TRACE_FULL;
+int event_driven = 1; // jump the clock to the next event when the CPU is idle (--tick disables)
+enum PacingMode pacing_mode = PACE_DEMO;
+long tick_length_us = 1000000;
+int pacing_set = 0;   // --pace given explicitly
+int batch_mode = 0;   // driven by a manifest, never reads the terminal
+int program_count = 0;
+int terminated_count = 0;
+int current_time = 0;
+int tick_in_progress = 0; // cores are executing current_time; whatever they wake can first run next tick
+FILE *program_output;                      // where `print` and `printFromTo` write (--program-output, stdout by default)
+int bench_report = 0;                      // --bench: print wall-clock performance figures at the end
+unsigned long dispatches = 0;              // context switches: processes put on a core
+unsigned long long scheduling_ns = 0;      // wall time spent deciding what runs, measured with --bench
+
+// Pre-recorded values answering `assign x input`
+char **input_stream = NULL;
+int input_count = 0;
+int input_next = 0;
+
 // Process states
 enum ProcessState {
-    READY, RUNNING, WAITING, BLOCKED, TERMINATED
+    READY, RUNNING, WAITING, BLOCKED, TERMINATED // WAITING: for an asynchronous file instruction to complete
 };
 
+// start_time of a process that has not been dispatched yet
+#define NOT_STARTED -1
+
 // Process Control Block (PCB)
 typedef struct PCB {
     int process_id;
     enum ProcessState state;
     unsigned int quantum;
-    unsigned int release_time;
-    unsigned int start_time;
+    int priority;                                    // 0 is the highest; raised while it holds a resource others need
+    int base_priority;                               // priority it was created with
+    int level;                                       // MLFQ level, 0 is the highest
+    unsigned int level_ticks;                        // ticks used at the current MLFQ level
+    unsigned int ticks_run;                          // instructions executed so far
+    unsigned int ready_since;                        // time it last joined a ready queue
+    int release_time;
+    int start_time;                                  // time of its first dispatch, NOT_STARTED until then
     unsigned int end_time;
     unsigned int program_counter;
-    int lower_memory_bound;
+    int lower_memory_bound;                          // private variable region, -1 while the process is not in memory
     int upper_memory_bound;
+    int image;                                       // index into images[] of the program it runs
+    int program_size;
+    int swapped;                                     // image is in the swap file, not in memory
+    int core;                                        // core it last ran on, -1 if it has not run
     char blocked_resource[20];
-    int var;
+    int waiting_on;                                  // resource it is blocked on, -1 if none
+    unsigned long blocked_since;                     // wait sequence number, orders waiters of equal priority
+    unsigned int blocked_at;                         // time it blocked
+    unsigned long deadlock_mark;                     // last deadlock search that visited it
+    int deadlock_stuck;                              // result of that search
+    int var;                                         // number of bound variables
+    int var_names[INPUT_SPACE_PER_PROCESS];          // symbol table: interned name of each variable slot
+    int condition;                                   // result of the last cmp: -1, 0 or 1
+    struct PCB *next;                                // queue links, a PCB is in at most one queue
+    struct PCB *prev;
+    struct Queue *queue;                             // queue currently holding the PCB, or NULL
+    struct ProcessThread *thread;                    // host thread in threaded mode, NULL until first dispatch
+    struct IORequest *io;                            // file instruction in flight while WAITING, else NULL
 } PCB;
 
-// Memory block structure
-typedef struct MemoryBlock {
-    char name[20];
-    char value[256];
-} MemoryBlock;
-
-MemoryBlock memory[MEMORY_SIZE]; // Simulated memory
+// Kind of data held in a memory word
+enum WordTag {
+    WORD_EMPTY, WORD_INSTRUCTION, WORD_FREE, WORD_VARIABLE
+};
 
-// Queue node structure
-typedef struct QueueNode {
-    PCB *process;
-    struct QueueNode *next;
-} QueueNode;
+// How a memory word holds its value
+enum WordState {
+    WORD_TEXT,   // the text in value_arena
+    WORD_PARSED, // the text, with the integer it parses to cached in word_int
+    WORD_INTEGER // word_int; the text is stale until wordValue renders it
+};
 
-// Queue structure
-typedef struct Queue {
-    QueueNode *front;
-    QueueNode *rear;
-} Queue;
+// Simulated memory, one array per field. Variable names are interned ids and
+// values are NUL-terminated strings in value_arena. Arithmetic results stay in
+// word_int and are only written out as text when something reads the value.
+unsigned char *word_tag;
+int *word_name;
+unsigned int *word_offset;
+unsigned short *word_length;
+unsigned short *word_capacity; // bytes reserved at word_offset, 0 if the word has no value
+long long *word_int;
+unsigned char *word_state;     // enum WordState
+int memory_size = DEFAULT_MEMORY_SIZE;
 
-Queue ready_queue;
-Queue running_queue;
-Queue started_queue;
-Queue blocked_queues[3]; // 0: file, 1: user input, 2: user output
+unsigned char *word_dirty;     // changed since the last trace
+int *dirty_words;              // indices of the dirty words
+int dirty_count = 0;
+unsigned long instructions_executed = 0;
 
+char *value_arena;
+size_t arena_used = 0, arena_capacity = 0;
+size_t arena_live = 0;         // bytes still reserved by some word
 
-// Initialize a queue
-void initQueue(Queue *queue) {
-    queue->front = queue->rear = NULL;
-}
+// Interned strings: variable names and instruction operands
+char **interned = NULL;
+int interned_count = 0, interned_capacity = 0;
+int *intern_table = NULL;      // open-addressing hash table of interned ids, -1 if empty
+int intern_table_size = 0;
 
-// Enqueue process
-void enqueue(Queue *queue, PCB *process) {
-    QueueNode *newNode = (QueueNode *)malloc(sizeof(QueueNode));
-    newNode->process = process;
-    newNode->next = NULL;
-    if (queue->rear == NULL) {
-        queue->front = queue->rear = newNode;
-    } else {
-        queue->rear->next = newNode;
-        queue->rear = newNode;
-    }
-}
+// A run of free memory words
+typedef struct FreeRegion {
+    int start;
+    int length;
+} FreeRegion;
 
-// Dequeue process
-PCB *dequeue(Queue *queue) {
-    if (queue->front == NULL)
-        return NULL;
-    QueueNode *temp = queue->front;
-    PCB *process = temp->process;
-    queue->front = queue->front->next;
-    if (queue->front == NULL)
-        queue->rear = NULL;
-    free(temp);
-    return process;
-}
+// Placement policy of the memory allocator
+enum FitPolicy {
+    FIT_FIRST, FIT_BEST
+};
 
-// Remove PCB from queue
-void removePCB(Queue *queue, int pcb_id) {
-    if (queue->front == NULL) {
-        return;
-    }
+FreeRegion *free_regions; // sorted by start address, adjacent regions are always merged
+int free_region_count;
+enum FitPolicy fit_policy = FIT_FIRST;
 
-    if (queue->front->process->process_id == pcb_id) {
-        QueueNode *temp = queue->front;
-        queue->front = queue->front->next;
-        free(temp);
-        if (queue->front == NULL) {
-            queue->rear = NULL;
-        }
-        return;
-    }
+// Backing store for swapped-out process images, one fixed slot per process
+int swap_enabled = 1;
+const char *swap_path = "OSms2.swap";
+int swap_fd = -1;
+char *swap_map = NULL;        // the swap file, memory-mapped on first swap-out
+size_t swap_map_size = 0;
+size_t *swap_offsets = NULL;  // slot of each process by id - 1
+unsigned long swap_outs = 0, swap_ins = 0;
+unsigned long long swap_bytes_out = 0, swap_bytes_in = 0;
 
-    QueueNode *prev = queue->front;
-    QueueNode *curr = queue->front->next;
-    while (curr != NULL && curr->process->process_id != pcb_id) {
-        prev = curr;
-        curr = curr->next;
-    }
+// Built-in resources, registered first so these are also their resource ids;
+// each also names the real I/O its mutex guards
+enum Resource {
+    RESOURCE_NONE = -1, RESOURCE_FILE, RESOURCE_USER_INPUT, RESOURCE_USER_OUTPUT, RESOURCE_COUNT
+};
 
-    if (curr != NULL) {
-        prev->next = curr->next;
-        if (curr == queue->rear) {
-            queue->rear = prev;
-        }
-        free(curr);
-    }
-}
+const char *resource_names[RESOURCE_COUNT] = {"file", "userInput", "userOutput"};
+sem_t *resource_mutexes[RESOURCE_COUNT] = {&file_mutex, &input_mutex, &output_mutex};
+int priority_inheritance = 0;         // --inherit: a holder runs at the priority of its most urgent waiter
+unsigned long wait_sequence = 0;
 
-// Function to load a program into memory and initialize its PCB
-PCB *loadProgram(int pid, char *program[], int program_size, int start_index, int release_time, unsigned int quantum) {
-    int mem_index = start_index;
+// What to do when processes deadlock
+enum DeadlockRecovery {
+    RECOVER_ABORT,    // report the cycle and stop the simulation
+    RECOVER_KILL,     // terminate a victim, releasing what it holds
+    RECOVER_ROLLBACK  // release what a victim holds and restart its program
+};
 
-    for (int i = 0; i < program_size; i++) {
-        strcpy(memory[start_index + i].name, "Instruction");
-        strcpy(memory[start_index + i].value, program[i]);
-        mem_index++;
-    }
-    // Reserve space for inputs
-    for (int i = 0; i < INPUT_SPACE_PER_PROCESS; i++) {
-        strcpy(memory[mem_index].name, "Free");
-        strcpy(memory[mem_index].value, "");
-        mem_index++;
-    }
+// Which deadlocked process is sacrificed
+enum VictimPolicy {
+    VICTIM_LOWEST_PRIORITY, // largest priority number, then youngest
+    VICTIM_YOUNGEST,        // latest release, then highest id
+    VICTIM_FEWEST_UNITS     // holds the fewest resource units, then youngest
+};
 
-    PCB *pcb = (PCB *)malloc(sizeof(PCB));
-    pcb->process_id = pid;
-    pcb->state = READY;
-    pcb->quantum = quantum;
-    pcb->release_time = release_time;
-    pcb->start_time = -1;  // Initialize start_time to -1 to indicate it hasn't started yet
-    pcb->end_time = -1;    // Initialize end_time to -1 to indicate it hasn't ended yet
-    pcb->program_counter = start_index;
-    pcb->lower_memory_bound = start_index;
-    pcb->upper_memory_bound = mem_index - 1;
-    pcb->var = 0;
-    strcpy(pcb->blocked_resource, "");
-    return pcb;
-}
+enum DeadlockRecovery deadlock_recovery = RECOVER_ABORT;
+enum VictimPolicy victim_policy = VICTIM_LOWEST_PRIORITY;
+unsigned long deadlock_generation = 0;
+int *deadlock_pending = NULL; // ids of processes found deadlocked as they blocked, resolved after the tick
+int deadlock_pending_count = 0;
+int deadlock_pending_capacity = 0;
+unsigned long deadlocks_detected = 0;
 
-// Print memory state
-void printMemory(int time) {
-    printf("\n-------------------------- Memory State at Time: %d--------------------------\n", time);
-    for (int i = 0; i < MEMORY_SIZE; i++) {
-        if (strlen(memory[i].name) > 0) {
-            printf("| %-3d | %-11s | %-20s |\n", i, memory[i].name, memory[i].value);
-        }
-    }
-    printf("-----------------------------------------------------------------------\n");
-}
+// Decoded instruction opcodes
+enum Opcode {
+    OP_MALFORMED,       // empty line
+    OP_UNKNOWN,         // unrecognized instruction, executed as a no-op
+    OP_SEM_WAIT,
+    OP_SEM_SIGNAL,
+    OP_ASSIGN,          // assign var value
+    OP_ASSIGN_INPUT,    // assign var input
+    OP_ASSIGN_READFILE, // assign var readFile file
+    OP_PRINT,
+    OP_PRINT_FROM_TO,
+    OP_WRITE_FILE,
+    OP_READ_FILE,
+    OP_DECLARE_RESOURCE, // resource name count, registered when the program is loaded
+    OP_ADD,             // add var operand: var = var + operand
+    OP_SUB,
+    OP_MUL,
+    OP_CMP,             // cmp var operand: remember how var compares with operand
+    OP_JUMP,            // jmp label
+    OP_JUMP_EQ,         // jeq/jne/jlt/jle/jgt/jge label, on the last comparison
+    OP_JUMP_NE,
+    OP_JUMP_LT,
+    OP_JUMP_LE,
+    OP_JUMP_GT,
+    OP_JUMP_GE,
+    OP_LABEL,           // label: a jump target, executed as a no-op
+    OPCODE_COUNT
+};
 
-// Print queue state
-void printQueue(const char *name, Queue *queue) {
-    printf("------ %s ------\n", name);
-    QueueNode *currentNode = queue->front;
-    while (currentNode != NULL) {
-        printf("| Process ID: %-3d |\n", currentNode->process->process_id);
-        currentNode = currentNode->next;
-    }
-    printf("--------------------\n");
-}
+// Instruction decoded once at load time, stored alongside its memory word
+typedef struct Instruction {
+    int arg1;               // interned operands
+    int arg2;
+    long long imm;          // arg2 if it is an integer literal; for jumps, the line after the label
+    short resource;
+    unsigned char opcode;   // enum Opcode
+    unsigned char literal;  // arg2 is an integer literal, held in imm
+    signed char slot1;      // variable slot arg1 resolved to, -1 until bound
+    signed char slot2;      // variable slot arg2 resolved to, -1 until bound
+} Instruction;
 
-// Print all queues state
-void printQueues(int time , int Q) {
-    printf("\n-------------------------- Queue States at Time: %d--------------------------\n", time);
-    switch (Q)
-    {
-    case 0:
-         printQueue("Running Queue", &running_queue);
-                  printQueue("Ready Queue", &ready_queue);
-                           printQueue("Started Queue", &started_queue);
+Instruction *decoded; // decoded instruction of each memory word
 
+// Queue structure, linked through the PCBs themselves
+typedef struct Queue {
+    PCB *front;
+    PCB *rear;
+    int size;
+    unsigned int version;        // bumped on every change
+    unsigned int traced_version; // version last shown by the trace
+} Queue;
 
+// Min-heap of processes in the order given by `before`
+typedef struct ProcessHeap {
+    PCB **items;
+    int size;
+    int capacity;
+    int (*before)(PCB *a, PCB *b);
+    unsigned int version;
+    unsigned int traced_version;
+} ProcessHeap;
 
-        break;
-    case 1:
-        break;
-    case 2:
-        break;
-    default:
-        break;
-    }
-    
-    
+// A simulated CPU with its own run queue
+typedef struct Core {
+    int id;
+    PCB *current;             // running process, NULL if idle
+    unsigned int slice_left;  // ticks left in the current quantum
+    Queue ready;              // local ready queue
+    unsigned long busy_ticks;
+    unsigned long steals;     // processes taken from other cores' queues
+} Core;
 
-    for (int i = 0; i < 3; i++) {
-        char blocked_name[20];
+// A scheduling policy. Hooks left NULL do nothing.
+typedef struct SchedulingPolicy {
+    const char *name;
+    int preemptive;                            // a better ready process takes a busy core mid-slice
+    int (*compare)(PCB *a, PCB *b);            // < 0 if a should run before b
+    PCB *(*pick_next)(Queue *ready);           // choose the next process, without removing it
+    unsigned int (*time_slice)(PCB *process);  // ticks it may run before its quantum expires
+    void (*on_arrival)(PCB *process);          // released and loaded into memory
+    void (*on_block)(PCB *process);
+    void (*on_quantum_expire)(PCB *process);
+    void (*on_terminate)(PCB *process);
+} SchedulingPolicy;
 
-        sprintf(blocked_name, "Blocked Queue %d", i);
-        printQueue(blocked_name, &blocked_queues[i]);
-    }
-}
+const SchedulingPolicy *policy;
+int aging_interval = 0;         // ticks of waiting that raise a ready process one priority level, 0 = static
+unsigned int lottery_state = 1; // lottery random number generator state (--seed)
+int mlfq_last_boost = 0;        // time of the last MLFQ priority boost
+int policy_set = 0;             // --policy given, overriding the policy of a restored checkpoint
 
+Core *cores;
+int core_count = 1;
 
-// Function to handle semWait
-void semWait(sem_t *sem, PCB *pcb, Queue *blocked_queue, const char *resource_name) {
-    if (sem_trywait(sem) == 0) {
-        return; // Successfully acquired the semaphore
-    } else {
-        pcb->state = BLOCKED;
-        strcpy(pcb->blocked_resource, resource_name);
-        enqueue(blocked_queue, pcb);
-    }
-}
+// Host thread running a process in threaded mode
+typedef struct ProcessThread {
+    pthread_t id;
+    pthread_cond_t turn;        // signalled when the dispatcher hands the process a tick
+    Core *core;                 // core of the pending tick, NULL while parked
+    int slot;                   // place of the pending tick in core order
+    struct timespec handed_at;  // when the pending tick was handed over
+    int prefetched;             // the tick's host I/O is already done, with the result below
+    unsigned char io_opcode;
+    int io_status;
+    char io_name[MAX_VALUE_LENGTH + 1];
+    char io_value[MAX_VALUE_LENGTH + 1];
+} ProcessThread;
 
-// Function to handle semSignal
-void semSignal(sem_t *sem, Queue *blocked_queue) {
-    sem_post(sem);
-    PCB *unblocked_process = dequeue(blocked_queue);
-    if (unblocked_process != NULL) {
-        unblocked_process->state = READY;
-        enqueue(&ready_queue, unblocked_process);
-    }
-}
+int threaded = 0;  // --threads: every process runs on its own host thread
+// Simulation state is only touched with kernel_lock held; a process thread drops it around real I/O.
+// The threads of one tick take turns in core order twice: to claim their I/O, then to run the tick.
+pthread_mutex_t kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ticks_done = PTHREAD_COND_INITIALIZER;
+pthread_cond_t turn_changed = PTHREAD_COND_INITIALIZER;
+int ticks_outstanding = 0;
+int prepare_turn = 0;               // slot of the thread that may claim its I/O next
+int commit_turn = 0;                // slot of the thread that may run its tick next
+unsigned long handoffs = 0;
+unsigned long long handoff_ns = 0;  // total dispatcher-to-thread wakeup latency
+unsigned long contended_io = 0;     // I/O sections that had to wait for their semaphore
+unsigned long long io_wait_ns = 0;
+// How file instructions are carried out
+enum IOMode {
+    IO_SYNC, // inside the issuing process's tick
+    IO_ASYNC // by the I/O worker pool, while the process waits off the CPU
+};
 
-// Function to simulate the Round Robin scheduling
-void rr_scheduling() {
-    int currentTime = 0;
-    int terminatedCount = 0;
+// A file instruction handed to the I/O worker pool
+typedef struct IORequest {
+    PCB *process;
+    Instruction *ins;
+    unsigned char opcode;
+    char name[MAX_VALUE_LENGTH + 1];
+    char value[MAX_VALUE_LENGTH + 1]; // data to write, or what was read
+    int status;                       // result of the read
+    int done;                         // a worker has carried it out
+    unsigned int issued_at;           // time the process started waiting
+    unsigned int complete_at;         // time it completes under a simulated latency
+    struct IORequest *next;           // in the submission queue
+} IORequest;
 
-    PCB *currentProcess = NULL;
+enum IOMode io_mode = IO_SYNC;
+int io_latency = 2;       // ticks a file instruction keeps its process waiting, -1 = until the host I/O is done
+int io_worker_count = 2;
+pthread_t *io_workers = NULL;
+// The submission queue and the done flags are only touched with io_lock held
+pthread_mutex_t io_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t io_submitted = PTHREAD_COND_INITIALIZER; // a request was queued, or the pool is stopping
+pthread_cond_t io_finished = PTHREAD_COND_INITIALIZER;  // a worker completed a request
+IORequest *io_pending_front = NULL, *io_pending_rear = NULL;
+int io_stopping = 0;
+unsigned long io_requests = 0;
+unsigned long long io_wait_ticks = 0;    // total ticks processes waited for their I/O
+unsigned long long io_stall_ns = 0;      // wall time the scheduler waited for a worker to catch up
+Queue running_queue;
+Queue io_wait_queue;     // waiting for a file instruction, in issue order
+Queue memory_wait_queue; // released but waiting for a free memory region
+ProcessHeap started_queue; // processes that have not been released yet, by release time
+PCB **processes;         // every process by id - 1, NULL once freed
 
-    while (1) {
-        // Move processes from started to ready based on release time
-        QueueNode *prevNode = NULL;
-        QueueNode *currentNode = started_queue.front;
+// A named resource: a counting semaphore with its own wait queue
+typedef struct ResourceEntry {
+    int name;             // interned name
+    int count;            // units in the pool
+    int declared;         // count set by a declaration, not defaulted to one
+    sem_t lock;           // units not handed out
+    PCB **holders;        // processes holding a unit, once per unit held
+    int holder_count;
+    int holder_capacity;
+    ProcessHeap waiters;  // blocked processes by priority, then wait time
+} ResourceEntry;
 
-        while (currentNode != NULL) {
-            if (currentNode->process->release_time <= currentTime) {
-                PCB *readyProcess = currentNode->process;
-                readyProcess->state = READY;
+ResourceEntry *resources = NULL;
+int resource_count = 0;
+int resource_capacity = 0;
+int *resource_index = NULL; // resource id of each interned name, -1 if it names none
+int resource_index_size = 0;
 
-                if (prevNode == NULL) {
-                    started_queue.front = currentNode->next;
-                    if (started_queue.front == NULL) {
-                        started_queue.rear = NULL;
-                    }
-                } else {
-                    prevNode->next = currentNode->next;
-                    if (prevNode->next == NULL) {
-                        started_queue.rear = prevNode;
-                    }
-                }
+// Scheduling history of one process, kept after its PCB is freed
+typedef struct ProcessMetrics {
+    unsigned int arrival;
+    unsigned int first_run;            // -1 until first dispatched
+    unsigned int completion;           // -1 until terminated
+    unsigned int cpu_ticks;
+    unsigned int ready_wait;           // ticks spent in ready queues
+    unsigned int blocked_wait;         // ticks spent blocked, on any resource
+    unsigned int io_wait;              // ticks spent waiting for asynchronous I/O
+    unsigned int *blocked_by_resource; // ticks blocked on each resource id
+    int blocked_resources;             // entries in blocked_by_resource
+    unsigned int preemptions;          // quantum expiries and policy preemptions
+    unsigned int context_switches;     // times it was put on a core
+    int killed;                        // terminated to break a deadlock
+} ProcessMetrics;
 
-                enqueue(&ready_queue, readyProcess);
+ProcessMetrics *metrics;  // by process id - 1
+const char *metrics_csv_path = NULL;
+const char *metrics_json_path = NULL;
 
-                QueueNode *temp = currentNode;
-                currentNode = currentNode->next;
-                free(temp);
-            } else {
-                prevNode = currentNode;
-                currentNode = currentNode->next;
-            }
+// Charge the time a process has been blocked since it blocked, now that it is woken
+void recordUnblocked(PCB *process) {
+    ProcessMetrics *m = &metrics[process->process_id - 1];
+    unsigned int ticks = current_time + tick_in_progress - process->blocked_at;
+    if (process->waiting_on >= m->blocked_resources) {
+        m->blocked_by_resource = realloc(m->blocked_by_resource, resource_count * sizeof(unsigned int));
+        if (m->blocked_by_resource == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
         }
+        memset(m->blocked_by_resource + m->blocked_resources, 0, (resource_count - m->blocked_resources) * sizeof(unsigned int));
+        m->blocked_resources = resource_count;
+    }
+    m->blocked_by_resource[process->waiting_on] += ticks;
+    m->blocked_wait += ticks;
+}
 
-        int executed = 0;
+// Kinds of record in a replay log
+enum ReplayRecord {
+    RECORD_INPUT,     // value read by `assign x input`
+    RECORD_FILE_READ, // status and value of a file read
+    RECORD_DISPATCH,  // process put on a core (argument: the core)
+    RECORD_BLOCK,     // process blocked on a resource (argument: the resource id)
+    RECORD_WAIT_IO,   // process waits for asynchronous I/O
+    RECORD_UNBLOCK,   // process handed a resource unit or done with its I/O (argument: the resource id, -1 for I/O)
+    RECORD_PREEMPT,   // process taken off its core (argument: the process preempting it)
+    RECORD_EXPIRE,    // quantum expired
+    RECORD_TERMINATE,
+    RECORD_COUNT
+};
 
-        // Execute the next process in the ready queue
-        if (currentProcess == NULL && ready_queue.front != NULL) {
-            printf("------------------------------------------------------------------Executing Process ID: %d at Time: %d------------------------------------------------------------------\n", ready_queue.front->process->process_id, currentTime);
-         printMemory(currentTime); // Print memory state every clock cycle
-               
-
-            currentProcess = dequeue(&ready_queue);
-             enqueue(&running_queue,currentProcess);
-                 
-                                 printQueues(currentTime,0); // Print queues after every scheduling event
-
-            currentProcess->state = RUNNING;
-            if (currentProcess->start_time == -1) {
-                currentProcess->start_time = currentTime;
-            }
-                
-        }
-
-        if (currentProcess != NULL) {
-            unsigned int time_slice = currentProcess->quantum;
-
-            for (unsigned int t = 0; t < time_slice&&strcmp(memory[currentProcess->program_counter].name, "Instruction") == 0; t++) {
-                printf("Current Time: %d\n", currentTime);
-                printf("Currently Executing Process ID: %d\n", currentProcess->process_id);
-                printf("Instruction: %s\n", memory[currentProcess->program_counter].value);
-
-                // Check if current memory block is an instruction
-                if (strcmp(memory[currentProcess->program_counter].name, "Instruction") != 0) {
-                    currentProcess->state = TERMINATED;
-                    currentProcess->end_time = currentTime;
-                    printf("Process ID: %d terminated.\n", currentProcess->process_id);
-                    free(currentProcess);
-                    currentProcess = NULL;
-                    terminatedCount++;
-                    break;
-                }
+const char *record_names[RECORD_COUNT] = {"an input", "a file read", "dispatch", "block", "I/O wait", "unblock", "preemption",
+                                          "quantum expiry", "termination"};
 
-                char instruction[256];
-                strcpy(instruction, memory[currentProcess->program_counter].value);
-
-                char *token = strtok(instruction, " ");
-                if (token == NULL) {
-                    printf("Malformed instruction encountered. Skipping...\n");
-                    if (currentProcess->program_counter + 1 <= currentProcess->upper_memory_bound) {
-                        currentProcess->program_counter++;
-                    }
-                    currentTime++;
-                    continue;
-                }
+const char *record_path = NULL;  // --record: append every external value and scheduling decision here
+const char *replay_path = NULL;  // --replay: take external values from this log and check every decision against it
+FILE *record_log = NULL;
+int replaying = 0;
+char *replay_data = NULL;        // the mapped log
+size_t replay_size = 0, replay_offset = 0;
+unsigned long replay_decisions = 0, replay_values = 0;
 
-                if (strcmp(token, "semWait") == 0) {
-                    token = strtok(NULL, " ");
-                    if (token != NULL) {
-                        if (strcmp(token, "file") == 0) {
-                            semWait(&file_mutex, currentProcess, &blocked_queues[0], "file");
-                        } else if (strcmp(token, "userInput") == 0) {
-                            semWait(&input_mutex, currentProcess, &blocked_queues[1], "userInput");
-                        } else if (strcmp(token, "userOutput") == 0) {
-                            semWait(&output_mutex, currentProcess, &blocked_queues[2], "userOutput");
-                        }
-                    }
-                } else if (strcmp(token, "semSignal") == 0) {
-                    token = strtok(NULL, " ");
-                    if (token != NULL) {
-                        if (strcmp(token, "file") == 0) {
-                            semSignal(&file_mutex, &blocked_queues[0]);
-                        } else if (strcmp(token, "userInput") == 0) {
-                            semSignal(&input_mutex, &blocked_queues[1]);
-                        } else if (strcmp(token, "userOutput") == 0) {
-                            semSignal(&output_mutex, &blocked_queues[2]);
-                        }
-                    }
-                } else if (strcmp(token, "assign") == 0) {
-    char var[20], value[256], data[256];
-    sscanf(memory[currentProcess->program_counter].value, "assign %s %[^\n]", var, value);
-
-    if (strcmp(value, "input") == 0) {
-        printf("Please enter a value for %s: ", var);
-        scanf("%s", data);
-        switch (currentProcess->var) {
-            case 0:
-                strcpy(memory[currentProcess->upper_memory_bound - 2].name, var);
-                strcpy(memory[currentProcess->upper_memory_bound - 2].value, data);
-                currentProcess->var++;
-                break;
-            case 1:
-                strcpy(memory[currentProcess->upper_memory_bound - 1].name, var);
-                strcpy(memory[currentProcess->upper_memory_bound - 1].value, data);
-                currentProcess->var++;
-                break;
-            case 2:
-                strcpy(memory[currentProcess->upper_memory_bound].name, var);
-                strcpy(memory[currentProcess->upper_memory_bound].value, data);
-                currentProcess->var++;
-                break;
-            case 3:
-                printf("No space left for the variable '%s'.\n", var);
-                break;
-            default:
-                printf("Error: Invalid input space index.\n");
-                break;
-        }
-    } else if (strncmp(value, "readFile", 8) == 0) {
-        // Extract the file name
-        char fileName[256];
-        sscanf(value, "readFile %s", fileName);
-        printf("File name is %s\n", fileName);  // Debug print statement
+void putBytes(FILE *out, const void *data, size_t size) {
+    fwrite(data, 1, size, out);
+}
 
-        // Open the file and read its content
-        FILE *file = fopen(fileName, "r");
-        if (file == NULL) {
-            printf("Error: Could not open file '%s'.\n", fileName);
-        } else {
-            char fileContent[256];
-            if (fgets(fileContent, sizeof(fileContent), file) != NULL) {
-                // Remove newline character if present
-                fileContent[strcspn(fileContent, "\n")] = '\0';
-
-                // Store file content in memory
-                switch (currentProcess->var) {
-                    case 0:
-                        strcpy(memory[currentProcess->upper_memory_bound - 2].name, var);
-                        strcpy(memory[currentProcess->upper_memory_bound - 2].value, fileContent);
-                        currentProcess->var++;
-                        break;
-                    case 1:
-                        strcpy(memory[currentProcess->upper_memory_bound - 1].name, var);
-                        strcpy(memory[currentProcess->upper_memory_bound - 1].value, fileContent);
-                        currentProcess->var++;
-                        break;
-                    case 2:
-                        strcpy(memory[currentProcess->upper_memory_bound].name, var);
-                        strcpy(memory[currentProcess->upper_memory_bound].value, fileContent);
-                        currentProcess->var++;
-                        break;
-                    case 3:
-                        printf("No space left for the variable '%s'.\n", var);
-                        break;
-                    default:
-                        printf("Error: Invalid input space index.\n");
-                        break;
-                }
-            } else {
-                printf("Error: Could not read from file '%s'.\n", fileName);
-            }
-            fclose(file);
-        }
-    } else {
-        // Handle assigning a value directly
-        switch (currentProcess->var) {
-            case 0:
-                strcpy(memory[currentProcess->upper_memory_bound - 2].name, var);
-                strcpy(memory[currentProcess->upper_memory_bound - 2].value, value);
-                currentProcess->var++;
-                break;
-            case 1:
-                strcpy(memory[currentProcess->upper_memory_bound - 1].name, var);
-                strcpy(memory[currentProcess->upper_memory_bound - 1].value, value);
-                currentProcess->var++;
-                break;
-            case 2:
-                strcpy(memory[currentProcess->upper_memory_bound].name, var);
-                strcpy(memory[currentProcess->upper_memory_bound].value, value);
-                currentProcess->var++;
-                break;
-            case 3:
-                printf("No space left for the variable '%s'.\n", var);
-                break;
-            default:
-                printf("Error: Invalid input space index.\n");
-                break;
-        }
-    }
+void putInt(FILE *out, int value) {
+    putBytes(out, &value, sizeof(value));
 }
-else if (strcmp(token, "print") == 0) {
-                    token = strtok(NULL, " ");
-                    if (token != NULL) {
-                        for (int i = 0; i < MEMORY_SIZE; i++) {
-                            if (strcmp(memory[i].name, token) == 0) {
-                                printf("%s\n", memory[i].value);
-                                break;
-                            }
-                        }
-                    }
-                } else if (strcmp(token, "printFromTo") == 0) {
-                    char var1[20], var2[20];
-                    sscanf(memory[currentProcess->program_counter].value, "printFromTo %s %s", var1, var2);
-                    int start, end;
-                    for (int i = 0; i < MEMORY_SIZE; i++) {
-                        if (strcmp(memory[i].name, var1) == 0) {
-                            start = atoi(memory[i].value);
-                        }
-                        if (strcmp(memory[i].name, var2) == 0) {
-                            end = atoi(memory[i].value);
-                        }
-                    }
-                    for (int i = start; i <= end; i++) {
-                        printf("%d\n", i);
-                    }
-                } else if (strcmp(token, "writeFile") == 0) {
-                    char filename[20], data[256];
-                    sscanf(memory[currentProcess->program_counter].value, "writeFile %s %s", filename, data);
-                    for(int i = currentProcess->upper_memory_bound-3;i<currentProcess->upper_memory_bound;i++){
-                        if(strcmp(memory[i].name,data)==0){
-                            strcpy(data,memory[i].value);
-                        }
-                    }
-                    FILE *file = fopen(filename, "w");
-                    if (file != NULL) {
-                        fprintf(file, "%s", data);
-                        fclose(file);
-                    }
-                } else if (strcmp(token, "readFile") == 0) {
-                    char filename[20], var[20];
-                    sscanf(memory[currentProcess->program_counter].value, "readFile %s %s", filename, var);
-                    FILE *file = fopen(filename, "r");
-                    if (file != NULL) {
-                        char data[256];
-                        fscanf(file, "%s", data);
-                        fclose(file);
-                        for (int i = 0; i < MEMORY_SIZE; i++) {
-                            if (strcmp(memory[i].name, var) == 0) {
-                                strcpy(memory[i].value, data);
-                                break;
-                            }
-                        }
-                    }
-                }
 
-                if (currentProcess->program_counter + 1 <= currentProcess->upper_memory_bound) {
-                    currentProcess->program_counter++;
-                }
-                currentTime++;
-               
+void putString(FILE *out, const char *text) {
+    int length = strlen(text);
+    putInt(out, length);
+    putBytes(out, text, length);
+}
 
-                if (currentProcess->state == BLOCKED) {
-                    currentProcess = NULL;
-                     PCB *donePros = dequeue(&running_queue);
+// Stop a replay whose run no longer matches its log
+void replayDiverged(const char *expected, const char *got) {
+    fflush(stdout);
+    fprintf(stderr, "Replay diverged at time %d after %lu decisions: the log has %s, this run has %s.\n", current_time,
+            replay_decisions, expected, got);
+    exit(EXIT_FAILURE);
+}
 
-                    break;
-                }
-                 printf("------------------------------------------------------------------Executing Process ID: %d at Time: %d------------------------------------------------------------------\n", currentProcess->process_id, currentTime);
-                     printMemory(currentTime); // Print memory state every clock cycle
-                 
-                    printQueues(currentTime,0); 
-
-                sleep(1);
-            }
-
-            if (currentProcess != NULL) {
-                if (currentProcess->program_counter > currentProcess->upper_memory_bound || strcmp(memory[currentProcess->program_counter].name, "Instruction") != 0) {
-                    currentProcess->state = TERMINATED;
-                    currentProcess->end_time = currentTime;
-                    printf("Process ID: %d terminated.\n", currentProcess->process_id);
-                    PCB *donePros = dequeue(&running_queue);
-
-                    free(currentProcess);
-                    currentProcess = NULL;
-                    terminatedCount++;
-                } else {
-                    currentProcess->state = READY;
-                    PCB *donePros = dequeue(&running_queue);
-                    enqueue(&ready_queue, currentProcess);
-                    currentProcess = NULL;
-                }
-            }
-            executed = 1;
-        }
+void takeReplay(void *data, size_t size) {
+    if (size > replay_size - replay_offset) {
+        replayDiverged("no more records", "more");
+    }
+    memcpy(data, replay_data + replay_offset, size);
+    replay_offset += size;
+}
 
-        if (!executed) {
-            currentTime++;
+// Log a scheduling decision, or check it against the next one in the log being replayed
+void noteDecision(enum ReplayRecord kind, int time, PCB *process, int arg) {
+    if (record_log != NULL) {
+        fputc(kind, record_log);
+        putInt(record_log, time);
+        putInt(record_log, process->process_id);
+        putInt(record_log, arg);
+    } else if (replaying) {
+        unsigned char logged;
+        int fields[3];
+        takeReplay(&logged, 1);
+        if (logged < RECORD_DISPATCH || logged >= RECORD_COUNT) {
+            replayDiverged(record_names[logged < RECORD_COUNT ? logged : RECORD_INPUT], record_names[kind]);
         }
-
-        if (terminatedCount == MAX_PROGRAMS) {
-            break;
+        takeReplay(fields, sizeof(fields));
+        if (logged != kind || fields[0] != time || fields[1] != process->process_id || fields[2] != arg) {
+            char expected[96], got[96];
+            sprintf(expected, "%s of process %d (%d) at time %d", record_names[logged], fields[1], fields[2], fields[0]);
+            sprintf(got, "%s of process %d (%d) at time %d", record_names[kind], process->process_id, arg, time);
+            replayDiverged(expected, got);
         }
     }
+    replay_decisions++;
 }
 
-void printStartedQueue(Queue *started) {
-    QueueNode *currentNode = started->front;
-    printf("Processes in started queue:\n");
-    while (currentNode != NULL) {
-        printf("| Process ID: %-3d |\n", currentNode->process->process_id);
-        printf("|   State: %-2d    |\n", currentNode->process->state);
-        printf("|   Quantum: %-3d  |\n", currentNode->process->quantum);
-        printf("|   Release Time: %-3d |\n", currentNode->process->release_time);
-        printf("|   Program Counter: %-3d |\n", currentNode->process->program_counter);
-        printf("|   Lower Memory Bound: %-3d |\n", currentNode->process->lower_memory_bound);
-        printf("|   Upper Memory Bound: %-3d |\n", currentNode->process->upper_memory_bound);
-        printf("|   Start Time: %-3d |\n", currentNode->process->start_time);
-        printf("|   End Time: %-3d |\n", currentNode->process->end_time);
-        currentNode = currentNode->next;
+// Log an external value, or replace it with the next one in the log being replayed.
+// `status` may be NULL for values that have none.
+void exchangeValue(enum ReplayRecord kind, int *status, char *value) {
+    int no_status = 0;
+    if (status == NULL) {
+        status = &no_status;
     }
+    if (record_log != NULL) {
+        unsigned short length = strlen(value);
+        fputc(kind, record_log);
+        putInt(record_log, *status);
+        putBytes(record_log, &length, sizeof(length));
+        putBytes(record_log, value, length);
+    } else if (replaying) {
+        unsigned char logged;
+        unsigned short length;
+        takeReplay(&logged, 1);
+        if (logged != kind) {
+            replayDiverged(record_names[logged < RECORD_COUNT ? logged : RECORD_INPUT], record_names[kind]);
+        }
+        takeReplay(status, sizeof(int));
+        takeReplay(&length, sizeof(length));
+        if (length > MAX_VALUE_LENGTH) {
+            replayDiverged("a corrupt value", record_names[kind]);
+        }
+        takeReplay(value, length);
+        value[length] = '\0';
+    }
+    replay_values++;
 }
 
-void cleanup() {
-    // Free all remaining PCBs in the queues
-    while (ready_queue.front != NULL) {
-        PCB *pcb = dequeue(&ready_queue);
-        free(pcb);
-    }
+// Initialize a queue
+void initQueue(Queue *queue) {
+    queue->front = queue->rear = NULL;
+    queue->size = 0;
+    queue->version = queue->traced_version = 0;
+}
 
-    while (blocked_queues[0].front != NULL) {
-        PCB *pcb = dequeue(&blocked_queues[0]);
-        free(pcb);
+// Remove PCB from queue
+void removePCB(Queue *queue, PCB *process) {
+    if (process->queue != queue) {
+        return;
     }
-    while (blocked_queues[1].front != NULL) {
-        PCB *pcb = dequeue(&blocked_queues[1]);
-        free(pcb);
+    if (process->prev != NULL) {
+        process->prev->next = process->next;
+    } else {
+        queue->front = process->next;
     }
-    while (blocked_queues[2].front != NULL) {
-        PCB *pcb = dequeue(&blocked_queues[2]);
-        free(pcb);
+    if (process->next != NULL) {
+        process->next->prev = process->prev;
+    } else {
+        queue->rear = process->prev;
     }
-
-    // Destroy the semaphores
-    sem_destroy(&file_mutex);
-    sem_destroy(&input_mutex);
-    sem_destroy(&output_mutex);
+    process->next = process->prev = NULL;
+    process->queue = NULL;
+    queue->size--;
+    queue->version++;
 }
 
-
-char **read_program(const char *filename, int *line_count) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Failed to open file");
-        return NULL;
+// Enqueue process, moving it out of the queue it is currently in
+void enqueue(Queue *queue, PCB *process) {
+    if (process->queue != NULL) {
+        removePCB(process->queue, process);
+    }
+    process->next = NULL;
+    process->prev = queue->rear;
+    process->queue = queue;
+    if (queue->rear == NULL) {
+        queue->front = queue->rear = process;
+    } else {
+        queue->rear->next = process;
+        queue->rear = process;
     }
+    queue->size++;
+    queue->version++;
+}
 
-    char **program = malloc(MAX_LINES * sizeof(char *));
-    if (!program) {
-        perror("Failed to allocate memory");
-        fclose(file);
-        return NULL;
+// Dequeue process
+PCB *dequeue(Queue *queue) {
+    PCB *process = queue->front;
+    if (process != NULL) {
+        removePCB(queue, process);
     }
+    return process;
+}
 
-    char line[MAX_LINE_LENGTH];
-    *line_count = 0;
+// Number of processes a core is responsible for right now
+int coreLoad(Core *core) {
+    return core->ready.size + (core->current != NULL);
+}
 
-    while (fgets(line, sizeof(line), file)) {
-        line[strcspn(line, "\n")] = '\0';  // Remove newline character
-        program[*line_count] = malloc(strlen(line) + 1);
-        if (!program[*line_count]) {
-            perror("Failed to allocate memory");
-            fclose(file);
-            return NULL;
+// Make a process ready on its previous core, or on the least loaded core if it has not run yet
+void makeReady(PCB *process) {
+    Core *core = &cores[0];
+    if (process->core >= 0) {
+        core = &cores[process->core];
+    } else {
+        for (int i = 1; i < core_count; i++) {
+            if (coreLoad(&cores[i]) < coreLoad(core)) {
+                core = &cores[i];
+            }
         }
-        strcpy(program[*line_count], line);
-        (*line_count)++;
     }
+    process->state = READY;
+    process->ready_since = current_time + tick_in_progress;
+    enqueue(&core->ready, process);
+}
 
-    fclose(file);
-    return program;
+// Initialize a process heap ordered by `before`
+void initHeap(ProcessHeap *heap, int (*before)(PCB *a, PCB *b)) {
+    heap->items = NULL;
+    heap->size = heap->capacity = 0;
+    heap->before = before;
+    heap->version = heap->traced_version = 0;
 }
-void readFileIntoArray(const char *filename, char *program[], int *lineCount) {
-    FILE *file = fopen(filename, "r");
-    if (file == NULL) {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
+
+// Release order: earlier release first, ties broken by process id
+int releasesBefore(PCB *a, PCB *b) {
+    if (a->release_time != b->release_time) {
+        return a->release_time < b->release_time;
     }
+    return a->process_id < b->process_id;
+}
 
-    char buffer[MAX_LINE_LENGTH];
-    *lineCount = 0;
+// Wait order: higher priority first, then the one that has waited longest
+int waitsBefore(PCB *a, PCB *b) {
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->blocked_since < b->blocked_since;
+}
 
-    while (fgets(buffer, MAX_LINE_LENGTH, file) != NULL) {
-        if (*lineCount >= MAX_LINES) {
-            fprintf(stderr, "Error: file has too many lines\n");
-            exit(EXIT_FAILURE);
+// Move the item at index i towards the leaves until the heap order holds
+void siftDown(ProcessHeap *heap, int i) {
+    PCB *item = heap->items[i];
+    while (2 * i + 1 < heap->size) {
+        int child = 2 * i + 1;
+        if (child + 1 < heap->size && heap->before(heap->items[child + 1], heap->items[child])) {
+            child++;
+        }
+        if (!heap->before(heap->items[child], item)) {
+            break;
         }
+        heap->items[i] = heap->items[child];
+        i = child;
+    }
+    heap->items[i] = item;
+}
 
-        program[*lineCount] = malloc(strlen(buffer) + 1);
-        if (program[*lineCount] == NULL) {
-            perror("Error allocating memory");
+// Add a process to a heap
+void pushHeap(ProcessHeap *heap, PCB *process) {
+    if (heap->size == heap->capacity) {
+        heap->capacity = heap->capacity == 0 ? 16 : heap->capacity * 2;
+        heap->items = realloc(heap->items, heap->capacity * sizeof(PCB *));
+        if (heap->items == NULL) {
+            perror("Failed to allocate memory");
             exit(EXIT_FAILURE);
         }
-        strcpy(program[*lineCount], buffer);
-        (*lineCount)++;
     }
+    int i = heap->size++;
+    heap->version++;
+    while (i > 0 && heap->before(process, heap->items[(i - 1) / 2])) {
+        heap->items[i] = heap->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->items[i] = process;
+}
 
-    fclose(file);
+// First process in heap order, or NULL if the heap is empty
+PCB *peekHeap(ProcessHeap *heap) {
+    return heap->size > 0 ? heap->items[0] : NULL;
 }
 
-void free_program(char **program, int line_count) {
-    for (int i = 0; i < line_count; i++) {
-        free(program[i]);
+// Remove and return the first process in heap order
+PCB *popHeap(ProcessHeap *heap) {
+    if (heap->size == 0) {
+        return NULL;
     }
-    free(program);
+    PCB *top = heap->items[0];
+    heap->version++;
+    heap->items[0] = heap->items[--heap->size];
+    if (heap->size > 0) {
+        siftDown(heap, 0);
+    }
+    return top;
 }
 
+// Restore the heap order after the keys of processes in it changed
+void reorderHeap(ProcessHeap *heap) {
+    for (int i = heap->size / 2 - 1; i >= 0; i--) {
+        siftDown(heap, i);
+    }
+    heap->version++;
+}
 
+// Remove a process from anywhere in a heap
+void removeFromHeap(ProcessHeap *heap, PCB *process) {
+    for (int i = 0; i < heap->size; i++) {
+        if (heap->items[i] == process) {
+            heap->items[i] = heap->items[--heap->size];
+            reorderHeap(heap);
+            return;
+        }
+    }
+}
 
+// Hash of a NUL-terminated string (FNV-1a)
+unsigned int hashString(const char *str) {
+    unsigned int hash = 2166136261u;
+    while (*str) {
+        hash = (hash ^ (unsigned char)*str++) * 16777619u;
+    }
+    return hash;
+}
 
+// Id of a string in the intern table, adding it if it is new
+int internString(const char *str) {
+    if (interned_count * 2 >= intern_table_size) {
+        int size = intern_table_size == 0 ? 64 : intern_table_size * 2;
+        int *table = malloc(size * sizeof(int));
+        if (table == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        memset(table, -1, size * sizeof(int));
+        for (int id = 0; id < interned_count; id++) {
+            unsigned int h = hashString(interned[id]) & (size - 1);
+            while (table[h] >= 0) {
+                h = (h + 1) & (size - 1);
+            }
+            table[h] = id;
+        }
+        free(intern_table);
+        intern_table = table;
+        intern_table_size = size;
+    }
 
-
-
-#define MaxNumberOfStrings 100
-#define MaxStringSize 100
-
-void rtrim(char *str) {
-    int i = strlen(str) - 1;
-    while (i >= 0 && (str[i] == '\n' || str[i] == '\r')) {
-        str[i] = '\0';
-        i--;
+    unsigned int h = hashString(str) & (intern_table_size - 1);
+    while (intern_table[h] >= 0) {
+        if (strcmp(interned[intern_table[h]], str) == 0) {
+            return intern_table[h];
+        }
+        h = (h + 1) & (intern_table_size - 1);
     }
-}
 
-void removeCarriageReturn(char *a[], int rows) {
-    for (int i = 0; i < rows; i++) {
-        rtrim(a[i]);
+    if (interned_count == interned_capacity) {
+        interned_capacity = interned_capacity == 0 ? 64 : interned_capacity * 2;
+        interned = realloc(interned, interned_capacity * sizeof(char *));
+        if (interned == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
     }
+    interned[interned_count] = strdup(str);
+    intern_table[h] = interned_count;
+    return interned_count++;
 }
 
-void insertIntoArray(char* a[], int row, char* str) {
-    a[row] = strdup(str);
+// String of an interned id
+const char *internName(int id) {
+    return interned[id];
 }
 
+// Record that a memory word changed since the last trace
+void markDirty(int index) {
+    if (!word_dirty[index]) {
+        word_dirty[index] = 1;
+        dirty_words[dirty_count++] = index;
+    }
+}
 
+// Forget which words changed
+void clearDirty() {
+    for (int i = 0; i < dirty_count; i++) {
+        word_dirty[dirty_words[i]] = 0;
+    }
+    dirty_count = 0;
+}
 
-// Function to read a file and return a 2D array of strings
-int ReadFile(char* array []  ,char *filename) {
-    int row = 0;
-
-    FILE *fh = fopen(filename, "r");
-    if (fh != NULL) {
-        char buffer[MaxStringSize];
-        while (fgets(buffer, MaxStringSize, fh) != NULL) {
-            insertIntoArray(array, row, buffer);
-            row++;
-            if (row >= MaxNumberOfStrings)
-                break;
+// Copy live values to the front of the arena, dropping the space of overwritten and freed values
+void compactArena() {
+    char *compacted = malloc(arena_capacity);
+    if (compacted == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    size_t used = 0;
+    for (int i = 0; i < memory_size; i++) {
+        if (word_capacity[i] > 0) {
+            memcpy(compacted + used, value_arena + word_offset[i], word_capacity[i]);
+            word_offset[i] = used;
+            used += word_capacity[i];
         }
-        removeCarriageReturn(array, row);
-        fclose(fh);
     }
-    return row;
+    free(value_arena);
+    value_arena = compacted;
+    arena_used = used;
 }
 
-void printArray(char* array[], int size) {
-    for (int i = 0; i < size; i++) {
-        if (array[i] != NULL) {
-            printf("%s\n", array[i]);
+// Reserve `size` bytes at the end of the arena, returns their offset
+size_t reserveArena(size_t size) {
+    if (arena_used + size > arena_capacity && arena_live * 2 < arena_used) {
+        compactArena();
+    }
+    if (arena_used + size > arena_capacity) {
+        while (arena_used + size > arena_capacity) {
+            arena_capacity = arena_capacity == 0 ? 4096 : arena_capacity * 2;
+        }
+        value_arena = realloc(value_arena, arena_capacity);
+        if (value_arena == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
         }
     }
+    size_t offset = arena_used;
+    arena_used += size;
+    arena_live += size;
+    return offset;
 }
 
-int  interpret(char* array[] , int  a ){
-    int size;
-    switch (a)
-    {
-    case 1:
-          size = ReadFile(array,"Program_1.txt");
-        break;
-
-    case 2:
-          size = ReadFile(array,"Program_2.txt");
-        break;
-    case 3:
-          size = ReadFile(array,"Program_3.txt");
-        break;
-    
-    default:
-        break;
+// Store a value in a memory word, reusing its arena space when the value fits
+void setWordValue(int index, const char *value) {
+    size_t length = strlen(value);
+    if (length > MAX_VALUE_LENGTH) {
+        length = MAX_VALUE_LENGTH;
+    }
+    if (length + 1 > word_capacity[index]) {
+        char copy[MAX_VALUE_LENGTH + 1];
+        memcpy(copy, value, length);  // the value may live in the arena, which can move
+        arena_live -= word_capacity[index];
+        word_capacity[index] = 0;     // lets compaction drop the old value
+        word_offset[index] = reserveArena(length + 1);
+        word_capacity[index] = length + 1;
+        value = copy;
+        memcpy(value_arena + word_offset[index], value, length);
+    } else {
+        memmove(value_arena + word_offset[index], value, length);
     }
+    value_arena[word_offset[index] + length] = '\0';
+    word_length[index] = length;
+    word_state[index] = WORD_TEXT;
+    markDirty(index);
+}
 
-                                                // actual used size
-    return size;
+// Value stored in a memory word, rendering a pending integer as text first
+const char *wordValue(int index) {
+    if (word_state[index] == WORD_INTEGER) {
+        char text[24];
+        snprintf(text, sizeof(text), "%lld", word_int[index]);
+        setWordValue(index, text);
+        word_state[index] = WORD_PARSED;
+    }
+    return word_capacity[index] > 0 ? value_arena + word_offset[index] : "";
 }
 
+// Mark a memory word as unused
+void clearWord(int index) {
+    arena_live -= word_capacity[index];
+    word_tag[index] = WORD_EMPTY;
+    word_name[index] = -1;
+    word_capacity[index] = word_length[index] = 0;
+    word_state[index] = WORD_TEXT;
+    markDirty(index);
+}
 
+// Label printed for a memory word
+const char *wordLabel(int index) {
+    switch (word_tag[index]) {
+        case WORD_INSTRUCTION:
+            return "Instruction";
+        case WORD_FREE:
+            return "Free";
+        case WORD_VARIABLE:
+            return internName(word_name[index]);
+        default:
+            return "";
+    }
+}
+
+// Id of the resource with the given name, registering a one-unit resource if it is new
+int resourceId(const char *name) {
+    int name_id = internString(name);
+    if (name_id >= resource_index_size) {
+        int size = resource_index_size == 0 ? 64 : resource_index_size;
+        while (size <= name_id) {
+            size *= 2;
+        }
+        resource_index = realloc(resource_index, size * sizeof(int));
+        if (resource_index == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        memset(resource_index + resource_index_size, -1, (size - resource_index_size) * sizeof(int));
+        resource_index_size = size;
+    }
+    if (resource_index[name_id] >= 0) {
+        return resource_index[name_id];
+    }
+
+    if (resource_count == resource_capacity) {
+        resource_capacity = resource_capacity == 0 ? 8 : resource_capacity * 2;
+        resources = realloc(resources, resource_capacity * sizeof(ResourceEntry));
+        if (resources == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    ResourceEntry *resource = &resources[resource_count];
+    resource->name = name_id;
+    resource->count = 1;
+    resource->declared = 0;
+    sem_init(&resource->lock, 0, 1);
+    resource->holders = NULL;
+    resource->holder_count = resource->holder_capacity = 0;
+    initHeap(&resource->waiters, waitsBefore);
+    resource_index[name_id] = resource_count;
+    return resource_count++;
+}
+
+// Record that a process holds one unit of a resource
+void addHolder(ResourceEntry *resource, PCB *pcb) {
+    if (resource->holder_count == resource->holder_capacity) {
+        resource->holder_capacity = resource->holder_capacity == 0 ? 4 : resource->holder_capacity * 2;
+        resource->holders = realloc(resource->holders, resource->holder_capacity * sizeof(PCB *));
+        if (resource->holders == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    resource->holders[resource->holder_count++] = pcb;
+}
+
+// Forget one unit of a resource held by a process, returns 0 if it held none
+int removeHolder(ResourceEntry *resource, PCB *pcb) {
+    for (int i = 0; i < resource->holder_count; i++) {
+        if (resource->holders[i] == pcb) {
+            resource->holders[i] = resource->holders[--resource->holder_count];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Number of units of a resource held by a process
+int unitsHeld(ResourceEntry *resource, PCB *pcb) {
+    int units = 0;
+    for (int i = 0; i < resource->holder_count; i++) {
+        units += resource->holders[i] == pcb;
+    }
+    return units;
+}
+
+// Return one unit of a resource: hand it straight to the first waiter, or put it back in the pool
+void releaseUnit(ResourceEntry *resource) {
+    PCB *waiter = popHeap(&resource->waiters);
+    if (waiter == NULL) {
+        sem_post(&resource->lock);
+        return;
+    }
+    // The unit never goes back to the pool; the waiter already passed its semWait
+    addHolder(resource, waiter);
+    noteDecision(RECORD_UNBLOCK, current_time + tick_in_progress, waiter, resource - resources);
+    recordUnblocked(waiter);
+    waiter->waiting_on = -1;
+    makeReady(waiter);
+}
+
+// Set the number of units of a resource, from a `resource` line in a program or the manifest.
+// The first declaration wins; later ones with another count are reported and ignored.
+void declareResource(const char *name, int count) {
+    int id = resourceId(name);
+    ResourceEntry *resource = &resources[id];
+    if (count <= 0 || (resource->declared && resource->count != count)) {
+        TRACE(TRACE_SUMMARY, "Resource '%s' keeps %d units, ignoring a declaration of %d.\n", name, resource->count, count);
+        return;
+    }
+    if (resource->declared) {
+        return;
+    }
+    resource->declared = 1;
+    for (; resource->count < count; resource->count++) {
+        releaseUnit(resource);
+    }
+    // Shrink only by units still in the pool
+    for (; resource->count > count && sem_trywait(&resource->lock) == 0; resource->count--) {
+    }
+}
+
+// Mnemonics of the arithmetic instructions, which take a variable and an operand, and of the jumps
+struct {
+    const char *name;
+    enum Opcode opcode;
+} operators[] = {
+    {"add", OP_ADD}, {"sub", OP_SUB}, {"mul", OP_MUL}, {"cmp", OP_CMP},
+    {"jmp", OP_JUMP}, {"jeq", OP_JUMP_EQ}, {"jne", OP_JUMP_NE}, {"jlt", OP_JUMP_LT},
+    {"jle", OP_JUMP_LE}, {"jgt", OP_JUMP_GT}, {"jge", OP_JUMP_GE},
+};
+
+// Opcode of an arithmetic or jump mnemonic, OP_UNKNOWN if it is neither
+enum Opcode operatorOpcode(const char *name) {
+    for (size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++) {
+        if (strcmp(name, operators[i].name) == 0) {
+            return operators[i].opcode;
+        }
+    }
+    return OP_UNKNOWN;
+}
+
+// Decode one line of program text into an instruction record
+void decodeInstruction(const char *text, Instruction *ins) {
+    char op[20] = "", arg1[20] = "", arg2[256] = "", value[256] = "";
+    size_t op_length;
+
+    ins->opcode = OP_UNKNOWN;
+    ins->resource = RESOURCE_NONE;
+    ins->slot1 = ins->slot2 = -1;
+    ins->imm = 0;
+    ins->literal = 0;
+
+    if (sscanf(text, "%19s", op) != 1) {
+        ins->opcode = OP_MALFORMED;
+    } else if (operatorOpcode(op) != OP_UNKNOWN) {
+        ins->opcode = operatorOpcode(op);
+        sscanf(text, "%*s %19s %19s", arg1, arg2);
+        // Jumps get their target when the program is decoded
+        char *end;
+        long long literal = strtoll(arg2, &end, 10);
+        if (end != arg2 && *end == '\0') {
+            ins->imm = literal;
+            ins->literal = 1;
+        }
+    } else if ((op_length = strlen(op)) > 1 && op[op_length - 1] == ':') {
+        ins->opcode = OP_LABEL;
+        op[op_length - 1] = '\0';
+        strcpy(arg1, op);
+    } else if (strcmp(op, "semWait") == 0 || strcmp(op, "semSignal") == 0) {
+        ins->opcode = strcmp(op, "semWait") == 0 ? OP_SEM_WAIT : OP_SEM_SIGNAL;
+        if (sscanf(text, "%*s %19s", arg1) == 1) {
+            ins->resource = resourceId(arg1);
+        }
+    } else if (strcmp(op, "resource") == 0) {
+        int count;
+        if (sscanf(text, "resource %19s %d", arg1, &count) == 2) {
+            ins->opcode = OP_DECLARE_RESOURCE;
+            declareResource(arg1, count);
+        }
+    } else if (strcmp(op, "assign") == 0) {
+        sscanf(text, "assign %19s %255[^\n]", arg1, value);
+        if (strcmp(value, "input") == 0) {
+            ins->opcode = OP_ASSIGN_INPUT;
+        } else if (strncmp(value, "readFile", 8) == 0) {
+            ins->opcode = OP_ASSIGN_READFILE;
+            sscanf(value, "readFile %255s", arg2);
+        } else {
+            ins->opcode = OP_ASSIGN;
+            strcpy(arg2, value);
+        }
+    } else if (strcmp(op, "print") == 0) {
+        ins->opcode = OP_PRINT;
+        sscanf(text, "print %19s", arg1);
+    } else if (strcmp(op, "printFromTo") == 0) {
+        ins->opcode = OP_PRINT_FROM_TO;
+        sscanf(text, "printFromTo %19s %19s", arg1, arg2);
+    } else if (strcmp(op, "writeFile") == 0) {
+        ins->opcode = OP_WRITE_FILE;
+        sscanf(text, "writeFile %19s %255s", arg1, arg2);
+    } else if (strcmp(op, "readFile") == 0) {
+        ins->opcode = OP_READ_FILE;
+        sscanf(text, "readFile %19s %19s", arg1, arg2);
+    }
+
+    ins->arg1 = internString(arg1);
+    ins->arg2 = internString(arg2);
+}
+
+// Allocate simulated memory and the free list covering all of it
+void initMemory() {
+    word_tag = calloc(memory_size, sizeof(unsigned char));
+    word_name = malloc(memory_size * sizeof(int));
+    word_offset = calloc(memory_size, sizeof(unsigned int));
+    word_length = calloc(memory_size, sizeof(unsigned short));
+    word_capacity = calloc(memory_size, sizeof(unsigned short));
+    word_int = calloc(memory_size, sizeof(long long));
+    word_state = calloc(memory_size, sizeof(unsigned char));
+    word_dirty = calloc(memory_size, sizeof(unsigned char));
+    dirty_words = malloc(memory_size * sizeof(int));
+    decoded = calloc(memory_size, sizeof(Instruction));
+    free_regions = malloc(memory_size * sizeof(FreeRegion));
+    if (word_tag == NULL || word_name == NULL || word_offset == NULL || word_length == NULL || word_capacity == NULL ||
+        word_int == NULL || word_state == NULL || word_dirty == NULL || dirty_words == NULL || decoded == NULL ||
+        free_regions == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < memory_size; i++) {
+        word_name[i] = -1;
+    }
+    free_regions[0].start = 0;
+    free_regions[0].length = memory_size;
+    free_region_count = 1;
+}
+
+// Allocate `length` contiguous words, returns the start index or -1
+int allocateRegion(int length) {
+    int chosen = -1;
+    for (int i = 0; i < free_region_count; i++) {
+        if (free_regions[i].length < length) {
+            continue;
+        }
+        if (chosen < 0 || free_regions[i].length < free_regions[chosen].length) {
+            chosen = i;
+        }
+        if (fit_policy == FIT_FIRST || free_regions[i].length == length) {
+            break;
+        }
+    }
+    if (chosen < 0) {
+        return -1;
+    }
+
+    int start = free_regions[chosen].start;
+    free_regions[chosen].start += length;
+    free_regions[chosen].length -= length;
+    if (free_regions[chosen].length == 0) {
+        memmove(&free_regions[chosen], &free_regions[chosen + 1], (free_region_count - chosen - 1) * sizeof(FreeRegion));
+        free_region_count--;
+    }
+    return start;
+}
+
+// Return a region to the free list, coalescing it with its neighbours
+void freeRegion(int start, int length) {
+    int i = 0;
+    while (i < free_region_count && free_regions[i].start < start) {
+        i++;
+    }
+
+    int merge_prev = i > 0 && free_regions[i - 1].start + free_regions[i - 1].length == start;
+    int merge_next = i < free_region_count && start + length == free_regions[i].start;
+
+    if (merge_prev && merge_next) {
+        free_regions[i - 1].length += length + free_regions[i].length;
+        memmove(&free_regions[i], &free_regions[i + 1], (free_region_count - i - 1) * sizeof(FreeRegion));
+        free_region_count--;
+    } else if (merge_prev) {
+        free_regions[i - 1].length += length;
+    } else if (merge_next) {
+        free_regions[i].start = start;
+        free_regions[i].length += length;
+    } else {
+        memmove(&free_regions[i + 1], &free_regions[i], (free_region_count - i) * sizeof(FreeRegion));
+        free_regions[i].start = start;
+        free_regions[i].length = length;
+        free_region_count++;
+    }
+}
+
+// A program file, read once and shared by every process that runs it. While any of those processes
+// is in memory its instructions occupy one text segment; each process only has its own variable region.
+typedef struct ProgramImage {
+    char *path;
+    char *text;           // file contents, each line NUL-terminated in place
+    size_t text_length;
+    int mapped;           // text is a private mapping of the file rather than a heap copy
+    char **lines;         // at most MAX_LINES, pointing into text
+    int size;
+    Instruction *decoded; // decoded when the text is first loaded, NULL until then
+    int text_base;        // first word of the text segment, -1 while it is not in memory
+    int residents;        // processes in memory that run this text
+} ProgramImage;
+
+ProgramImage *images = NULL;
+int image_count = 0;
+int image_capacity = 0;
+int *image_table = NULL;       // open-addressing index into images by path hash
+int image_table_size = 0;
+
+// Index of the cached image of a program file, -1 if it has not been read
+int findImage(const char *path) {
+    if (image_table_size == 0) {
+        return -1;
+    }
+    unsigned int h = hashString(path) & (image_table_size - 1);
+    while (image_table[h] >= 0) {
+        if (strcmp(images[image_table[h]].path, path) == 0) {
+            return image_table[h];
+        }
+        h = (h + 1) & (image_table_size - 1);
+    }
+    return -1;
+}
+
+// Add a program to the image cache, splitting `text` into lines in place. `text` must have
+// one writable byte past `length`; the image owns it from now on. Returns the image index.
+int addImage(const char *path, char *text, size_t length, int mapped) {
+    if (image_count * 2 >= image_table_size) {
+        int size = image_table_size == 0 ? 64 : image_table_size * 2;
+        int *table = malloc(size * sizeof(int));
+        if (table == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        memset(table, -1, size * sizeof(int));
+        for (int i = 0; i < image_count; i++) {
+            unsigned int h = hashString(images[i].path) & (size - 1);
+            while (table[h] >= 0) {
+                h = (h + 1) & (size - 1);
+            }
+            table[h] = i;
+        }
+        free(image_table);
+        image_table = table;
+        image_table_size = size;
+    }
+    if (image_count == image_capacity) {
+        image_capacity = image_capacity == 0 ? 16 : image_capacity * 2;
+        images = realloc(images, image_capacity * sizeof(ProgramImage));
+        if (images == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Lines end at '\n' with any '\r' before it dropped; lines past MAX_LINES are ignored
+    char *lines[MAX_LINES];
+    int size = 0;
+    char *line = text, *end = text + length;
+    while (line < end && size < MAX_LINES) {
+        char *newline = memchr(line, '\n', end - line);
+        char *stop = newline != NULL ? newline : end;
+        char *next = stop + 1;
+        while (stop > line && stop[-1] == '\r') {
+            stop--;
+        }
+        *stop = '\0';
+        lines[size++] = line;
+        line = next;
+    }
+
+    ProgramImage *image = &images[image_count];
+    image->path = strdup(path);
+    image->text = text;
+    image->text_length = length;
+    image->mapped = mapped;
+    image->lines = malloc((size + 1) * sizeof(char *));
+    if (image->path == NULL || image->lines == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(image->lines, lines, size * sizeof(char *));
+    image->size = size;
+    image->decoded = NULL;
+    image->text_base = -1;
+    image->residents = 0;
+
+    unsigned int h = hashString(path) & (image_table_size - 1);
+    while (image_table[h] >= 0) {
+        h = (h + 1) & (image_table_size - 1);
+    }
+    image_table[h] = image_count;
+    return image_count++;
+}
+
+// Index of the image of a program file, reading the file with a single mapping the first time
+// it is named. Every later process running the same path shares that image.
+int loadImage(const char *path) {
+    int index = findImage(path);
+    if (index >= 0) {
+        return index;
+    }
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Could not open program '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    size_t length = info.st_size;
+    char *text = NULL;
+    int mapped = 0;
+    if (length > 0) {
+        // A private mapping lets the lines be terminated in place; the byte past the end is the zero
+        // fill of the last page unless the file ends exactly on a page boundary
+        text = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) {
+            perror("Failed to map program");
+            exit(EXIT_FAILURE);
+        }
+        mapped = 1;
+        if (length % sysconf(_SC_PAGESIZE) == 0 && text[length - 1] != '\n') {
+            char *copy = malloc(length + 1);
+            if (copy == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            memcpy(copy, text, length);
+            munmap(text, length);
+            text = copy;
+            mapped = 0;
+        }
+    }
+    close(fd);
+    return addImage(path, text, length, mapped);
+}
+
+// Add a program whose lines were stored in a checkpoint or replay log, unless it is already cached
+int addImageLines(const char *path, char **lines, int size) {
+    int index = findImage(path);
+    if (index >= 0) {
+        return index;
+    }
+    size_t length = 0;
+    for (int i = 0; i < size; i++) {
+        length += strlen(lines[i]) + 1;
+    }
+    char *text = malloc(length + 1);
+    if (text == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    char *cursor = text;
+    for (int i = 0; i < size; i++) {
+        cursor += sprintf(cursor, "%s\n", lines[i]);
+    }
+    return addImage(path, text, length, 0);
+}
+
+// Release every cached program image
+void freeImages() {
+    for (int i = 0; i < image_count; i++) {
+        if (images[i].mapped) {
+            munmap(images[i].text, images[i].text_length);
+        } else {
+            free(images[i].text);
+        }
+        free(images[i].path);
+        free(images[i].lines);
+        free(images[i].decoded);
+    }
+    free(images);
+    free(image_table);
+    images = NULL;
+    image_table = NULL;
+    image_count = image_capacity = image_table_size = 0;
+}
+
+// Initialize the PCB of a process; its program is loaded into memory on admission
+PCB *createProcess(int pid, int image, int release_time, unsigned int quantum, int priority) {
+    PCB *pcb = (PCB *)malloc(sizeof(PCB));
+    pcb->process_id = pid;
+    pcb->state = READY;
+    pcb->quantum = quantum;
+    pcb->priority = priority;
+    pcb->base_priority = priority;
+    pcb->waiting_on = -1;
+    pcb->blocked_since = 0;
+    pcb->blocked_at = 0;
+    pcb->deadlock_mark = 0;
+    pcb->deadlock_stuck = 0;
+    pcb->level = 0;
+    pcb->level_ticks = 0;
+    pcb->ticks_run = 0;
+    pcb->ready_since = 0;
+    pcb->release_time = release_time;
+    pcb->start_time = NOT_STARTED;
+    pcb->end_time = -1;    // Initialize end_time to -1 to indicate it hasn't ended yet
+    pcb->program_counter = 0;
+    pcb->lower_memory_bound = -1;
+    pcb->upper_memory_bound = -1;
+    pcb->image = image;
+    pcb->program_size = images[image].size;
+    pcb->swapped = 0;
+    pcb->core = -1;
+    pcb->var = 0;
+    pcb->next = pcb->prev = NULL;
+    pcb->queue = NULL;
+    pcb->thread = NULL;
+    pcb->io = NULL;
+    for (int i = 0; i < INPUT_SPACE_PER_PROCESS; i++) {
+        pcb->var_names[i] = -1;
+    }
+    pcb->condition = 0;
+    strcpy(pcb->blocked_resource, "");
+    return pcb;
+}
+
+// Drop a process's reference to its program's text segment, freeing the segment after the last one
+void detachText(PCB *pcb) {
+    ProgramImage *image = &images[pcb->image];
+    if (--image->residents > 0) {
+        return;
+    }
+    for (int i = 0; i < image->size; i++) {
+        clearWord(image->text_base + i);
+    }
+    if (image->size > 0) {
+        freeRegion(image->text_base, image->size);
+    }
+    image->text_base = -1;
+}
+
+// Release the variable region of a process and its share of the text segment
+void unloadProgram(PCB *pcb) {
+    if (pcb->lower_memory_bound < 0) {
+        return;
+    }
+    for (int i = pcb->lower_memory_bound; i <= pcb->upper_memory_bound; i++) {
+        clearWord(i);
+    }
+    freeRegion(pcb->lower_memory_bound, INPUT_SPACE_PER_PROCESS);
+    pcb->lower_memory_bound = pcb->upper_memory_bound = -1;
+    detachText(pcb);
+}
+
+// Whether a process has run past the last instruction of its program
+int programEnded(PCB *pcb) {
+    ProgramImage *image = &images[pcb->image];
+    return (int)pcb->program_counter >= image->text_base + image->size;
+}
+
+// Saved state at the start of a swap slot, followed by the words of the variable region.
+// The text is shared and read-only, so it is never swapped; it is reloaded from the image.
+// The PCB itself stays in host memory while the process is swapped out.
+typedef struct SwapHeader {
+    int words;
+    int pc_offset;
+} SwapHeader;
+
+// One memory word in a swap slot, followed by its value bytes
+typedef struct SwapWord {
+    int name;
+    unsigned short length;
+    unsigned char tag;
+} SwapWord;
+
+// Largest number of bytes a swapped image of `words` words can occupy
+size_t swapImageSize(int words) {
+    return sizeof(SwapHeader) + words * (sizeof(SwapWord) + MAX_VALUE_LENGTH);
+}
+
+// Lay out one swap slot per process; the file itself is created on first use
+void initSwap() {
+    size_t offset = 0;
+    swap_offsets = malloc(program_count * sizeof(size_t));
+    for (int i = 0; i < program_count; i++) {
+        swap_offsets[i] = offset;
+        if (processes[i] != NULL) { // NULL only for processes a restored checkpoint saw finish
+            offset += (swapImageSize(INPUT_SPACE_PER_PROCESS) + 63) & ~(size_t)63;
+        }
+    }
+    swap_map_size = offset;
+}
+
+// Create and map the swap file
+int openSwap() {
+    swap_fd = open(swap_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (swap_fd < 0 || ftruncate(swap_fd, swap_map_size) != 0) {
+        perror("Failed to create swap file");
+        return -1;
+    }
+    swap_map = mmap(NULL, swap_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, swap_fd, 0);
+    if (swap_map == MAP_FAILED) {
+        perror("Failed to map swap file");
+        swap_map = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Write the variable region of a resident process to its swap slot and free its memory
+int swapOut(PCB *pcb) {
+    if (swap_map == NULL && openSwap() < 0) {
+        swap_enabled = 0;
+        return -1;
+    }
+    char *slot = swap_map + swap_offsets[pcb->process_id - 1];
+    SwapHeader *header = (SwapHeader *)slot;
+    header->words = INPUT_SPACE_PER_PROCESS;
+    header->pc_offset = pcb->program_counter - images[pcb->image].text_base;
+    char *cursor = slot + sizeof(SwapHeader);
+    for (int i = pcb->lower_memory_bound; i <= pcb->upper_memory_bound; i++) {
+        const char *value = wordValue(i); // the length is only known once a pending integer is rendered
+        SwapWord word = {word_name[i], word_length[i], word_tag[i]};
+        memcpy(cursor, &word, sizeof(SwapWord));
+        memcpy(cursor + sizeof(SwapWord), value, word.length);
+        cursor += sizeof(SwapWord) + word.length;
+    }
+
+    TRACE(TRACE_EVENT, "Process ID: %d swapped out.\n", pcb->process_id);
+    unloadProgram(pcb);
+    pcb->swapped = 1;
+    swap_outs++;
+    swap_bytes_out += cursor - slot;
+    return 0;
+}
+
+// Pick a resident process to swap out: a blocked one first, otherwise the one that will run last
+PCB *chooseSwapVictim(PCB *exclude) {
+    for (int i = 0; i < resource_count; i++) {
+        for (int j = 0; j < resources[i].waiters.size; j++) {
+            PCB *process = resources[i].waiters.items[j];
+            if (process != exclude && process->lower_memory_bound >= 0) {
+                return process;
+            }
+        }
+    }
+    for (int i = 0; i < core_count; i++) {
+        for (PCB *process = cores[i].ready.rear; process != NULL; process = process->prev) {
+            if (process != exclude && process->lower_memory_bound >= 0) {
+                return process;
+            }
+        }
+    }
+    return NULL;
+}
+
+// Allocate `length` words of memory for a process, swapping other processes out if needed
+int allocateMemory(PCB *pcb, int length) {
+    int start_index = allocateRegion(length);
+    while (start_index < 0 && swap_enabled) {
+        PCB *victim = chooseSwapVictim(pcb);
+        if (victim == NULL || swapOut(victim) < 0) {
+            break;
+        }
+        start_index = allocateRegion(length);
+    }
+    return start_index;
+}
+
+// Decode the lines of a program and point each jump at the line after its label
+void decodeImage(ProgramImage *image) {
+    image->decoded = malloc((image->size + 1) * sizeof(Instruction));
+    if (image->decoded == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < image->size; i++) {
+        decodeInstruction(image->lines[i], &image->decoded[i]);
+    }
+    for (int i = 0; i < image->size; i++) {
+        Instruction *ins = &image->decoded[i];
+        if (ins->opcode < OP_JUMP || ins->opcode > OP_JUMP_GE) {
+            continue;
+        }
+        int target = -1;
+        for (int j = 0; j < image->size && target < 0; j++) {
+            if (image->decoded[j].opcode == OP_LABEL && image->decoded[j].arg1 == ins->arg1) {
+                target = j + 1;
+            }
+        }
+        if (target < 0) {
+            TRACE(TRACE_SUMMARY, "Unknown label '%s' in %s, the jump is ignored.\n", internName(ins->arg1), image->path);
+            ins->opcode = OP_UNKNOWN;
+        }
+        ins->imm = target;
+    }
+}
+
+// Take a reference to the text segment of a process's program, loading the program into a new
+// segment if no process in memory runs it. The program is decoded the first time only.
+int attachText(PCB *pcb) {
+    ProgramImage *image = &images[pcb->image];
+    if (image->text_base < 0) {
+        int start_index = image->size > 0 ? allocateMemory(pcb, image->size) : 0;
+        if (start_index < 0) {
+            return -1;
+        }
+        if (image->decoded == NULL) {
+            decodeImage(image);
+        }
+        for (int i = 0; i < image->size; i++) {
+            word_tag[start_index + i] = WORD_INSTRUCTION;
+            setWordValue(start_index + i, image->lines[i]);
+            decoded[start_index + i] = image->decoded[i];
+        }
+        image->text_base = start_index;
+    }
+    image->residents++;
+    return 0;
+}
+
+// Map the shared text of a process and allocate its private variable region, returns -1 if memory is full
+int mapProcess(PCB *pcb) {
+    if (attachText(pcb) < 0) {
+        return -1;
+    }
+    int start_index = allocateMemory(pcb, INPUT_SPACE_PER_PROCESS);
+    if (start_index < 0) {
+        detachText(pcb);
+        return -1;
+    }
+    pcb->lower_memory_bound = start_index;
+    pcb->upper_memory_bound = start_index + INPUT_SPACE_PER_PROCESS - 1;
+    return 0;
+}
+
+// Bring a swapped process back into memory
+int swapIn(PCB *pcb) {
+    if (mapProcess(pcb) < 0) {
+        return -1;
+    }
+    int start_index = pcb->lower_memory_bound;
+    char *slot = swap_map + swap_offsets[pcb->process_id - 1];
+    SwapHeader *header = (SwapHeader *)slot;
+    int words = header->words;
+    char *cursor = slot + sizeof(SwapHeader);
+    for (int i = start_index; i < start_index + words; i++) {
+        SwapWord word;
+        char value[MAX_VALUE_LENGTH + 1];
+        memcpy(&word, cursor, sizeof(SwapWord));
+        memcpy(value, cursor + sizeof(SwapWord), word.length);
+        value[word.length] = '\0';
+        word_tag[i] = word.tag;
+        word_name[i] = word.name;
+        setWordValue(i, value);
+        cursor += sizeof(SwapWord) + word.length;
+    }
+
+    pcb->program_counter = images[pcb->image].text_base + header->pc_offset;
+    pcb->swapped = 0;
+    TRACE(TRACE_EVENT, "Process ID: %d swapped in.\n", pcb->process_id);
+    swap_ins++;
+    swap_bytes_in += cursor - slot;
+    return 0;
+}
+
+// Unmap and remove the swap file
+void closeSwap() {
+    if (swap_map != NULL) {
+        munmap(swap_map, swap_map_size);
+    }
+    if (swap_fd >= 0) {
+        close(swap_fd);
+        unlink(swap_path);
+    }
+    free(swap_offsets);
+}
+
+// Function to load a program into memory, sharing its text with other processes running it;
+// returns -1 if there is no room
+int loadProgram(PCB *pcb) {
+    if (mapProcess(pcb) < 0) {
+        return -1;
+    }
+    // Reserve space for inputs
+    for (int i = pcb->lower_memory_bound; i <= pcb->upper_memory_bound; i++) {
+        word_tag[i] = WORD_FREE;
+        markDirty(i);
+    }
+    pcb->program_counter = images[pcb->image].text_base;
+    return 0;
+}
+
+// Print memory state
+void printMemory(int time) {
+    printf("\n-------------------------- Memory State at Time: %d--------------------------\n", time);
+    for (int i = 0; i < memory_size; i++) {
+        if (word_tag[i] != WORD_EMPTY) {
+            printf("| %-3d | %-11s | %-20s |\n", i, wordLabel(i), wordValue(i));
+        }
+    }
+    printf("-----------------------------------------------------------------------\n");
+}
+
+// Print queue state
+void printQueue(const char *name, Queue *queue) {
+    printf("------ %s ------\n", name);
+    for (PCB *process = queue->front; process != NULL; process = process->next) {
+        printf("| Process ID: %-3d |\n", process->process_id);
+    }
+    printf("--------------------\n");
+}
+
+int (*sorting_before)(PCB *a, PCB *b); // order compareHeapOrder sorts by
+
+// qsort comparison in the order of the heap being sorted; heap orders never tie
+int compareHeapOrder(const void *a, const void *b) {
+    PCB *x = *(PCB *const *)a, *y = *(PCB *const *)b;
+    return sorting_before(x, y) ? -1 : sorting_before(y, x);
+}
+
+// A copy of the processes of a heap in heap order, to be freed by the caller
+PCB **sortHeap(ProcessHeap *heap) {
+    PCB **sorted = malloc((heap->size + 1) * sizeof(PCB *));
+    if (sorted == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(sorted, heap->items, heap->size * sizeof(PCB *));
+    sorting_before = heap->before;
+    qsort(sorted, heap->size, sizeof(PCB *), compareHeapOrder);
+    return sorted;
+}
+
+void printHeap(const char *name, ProcessHeap *heap) {
+    PCB **sorted = sortHeap(heap);
+    printf("------ %s ------\n", name);
+    for (int i = 0; i < heap->size; i++) {
+        printf("| Process ID: %-3d |\n", sorted[i]->process_id);
+    }
+    printf("--------------------\n");
+    free(sorted);
+}
+
+// Trace name of a resource's wait queue; declared resources also show their name
+void blockedQueueName(int id, char *name) {
+    if (id < RESOURCE_COUNT) {
+        sprintf(name, "Blocked Queue %d", id);
+    } else {
+        sprintf(name, "Blocked Queue %d (%s)", id, internName(resources[id].name));
+    }
+}
+
+void printQueues(int time , int Q) {
+    printf("\n-------------------------- Queue States at Time: %d--------------------------\n", time);
+    switch (Q)
+    {
+    case 0:
+         printQueue("Running Queue", &running_queue);
+                  for (int i = 0; i < core_count; i++) {
+                      char ready_name[32];
+                      sprintf(ready_name, core_count == 1 ? "Ready Queue" : "Ready Queue (Core %d)", i);
+                      printQueue(ready_name, &cores[i].ready);
+                  }
+                           printHeap("Started Queue", &started_queue);
+                           if (memory_wait_queue.size > 0) {
+                               printQueue("Memory Wait Queue", &memory_wait_queue);
+                           }
+                           if (io_wait_queue.size > 0) {
+                               printQueue("I/O Wait Queue", &io_wait_queue);
+                           }
+
+
+
+        break;
+    case 1:
+        break;
+    case 2:
+        break;
+    default:
+        break;
+    }
+    
+    
+
+    for (int i = 0; i < resource_count; i++) {
+        char blocked_name[64];
+        blockedQueueName(i, blocked_name);
+        printHeap(blocked_name, &resources[i].waiters);
+    }
+}
+
+
+// Print the memory words that changed since the last trace
+void traceMemoryDelta() {
+    for (int i = 0; i < dirty_count; i++) {
+        int index = dirty_words[i];
+        printf("  | %-3d | %-11s | %-20s |\n", index, word_tag[index] == WORD_EMPTY ? "(released)" : wordLabel(index), wordValue(index));
+    }
+    clearDirty();
+}
+
+// Print a queue on one line if its membership changed since the last trace
+void traceQueueDelta(const char *name, Queue *queue) {
+    if (queue->version == queue->traced_version) {
+        return;
+    }
+    queue->traced_version = queue->version;
+    printf("  %s:", name);
+    for (PCB *process = queue->front; process != NULL; process = process->next) {
+        printf(" %d", process->process_id);
+    }
+    printf("\n");
+}
+
+// Print a heap in heap order if it changed since it was last traced
+void traceHeapDelta(const char *name, ProcessHeap *heap) {
+    if (heap->version == heap->traced_version) {
+        return;
+    }
+    heap->traced_version = heap->version;
+    PCB **sorted = sortHeap(heap);
+    printf("  %s:", name);
+    for (int i = 0; i < heap->size; i++) {
+        printf(" %d", sorted[i]->process_id);
+    }
+    printf("\n");
+    free(sorted);
+}
+
+// Trace the simulator state after a scheduling event or an executed instruction
+void traceState(int time, PCB *process) {
+    if (trace_level == TRACE_FULL) {
+        printf("------------------------------------------------------------------Executing Process ID: %d at Time: %d------------------------------------------------------------------\n", process->process_id, time);
+        printMemory(time); // Print memory state every clock cycle
+        printQueues(time, 0);
+        clearDirty();
+    } else if (trace_level == TRACE_EVENT) {
+        traceMemoryDelta();
+        traceQueueDelta("Running Queue", &running_queue);
+        for (int i = 0; i < core_count; i++) {
+            char ready_name[32];
+            sprintf(ready_name, core_count == 1 ? "Ready Queue" : "Ready Queue (Core %d)", i);
+            traceQueueDelta(ready_name, &cores[i].ready);
+        }
+        if (started_queue.version != started_queue.traced_version) {
+            started_queue.traced_version = started_queue.version;
+            printf("  Started Queue: %d waiting\n", started_queue.size);
+        }
+        traceQueueDelta("Memory Wait Queue", &memory_wait_queue);
+        traceQueueDelta("I/O Wait Queue", &io_wait_queue);
+        for (int i = 0; i < resource_count; i++) {
+            char blocked_name[64];
+            blockedQueueName(i, blocked_name);
+            traceHeapDelta(blocked_name, &resources[i].waiters);
+        }
+    } else {
+        clearDirty();
+    }
+}
+
+// Raise the priority of every holder of a resource to that of a process it blocks, following
+// the chain through holders that are themselves blocked
+void inheritPriority(int id, int priority) {
+    ResourceEntry *resource = &resources[id];
+    for (int i = 0; i < resource->holder_count; i++) {
+        PCB *holder = resource->holders[i];
+        if (priority >= holder->priority) {
+            continue;
+        }
+        holder->priority = priority;
+        TRACE(TRACE_EVENT, "Process ID: %d inherits priority %d.\n", holder->process_id, priority);
+        if (holder->waiting_on >= 0) {
+            reorderHeap(&resources[holder->waiting_on].waiters);
+            inheritPriority(holder->waiting_on, priority);
+        }
+    }
+}
+
+// Drop a process back to its own priority, keeping what it inherits through resources it still holds
+void restorePriority(PCB *process) {
+    int priority = process->base_priority;
+    for (int i = 0; i < resource_count; i++) {
+        PCB *waiter = peekHeap(&resources[i].waiters);
+        if (waiter != NULL && waiter->priority < priority && unitsHeld(&resources[i], process) > 0) {
+            priority = waiter->priority;
+        }
+    }
+    process->priority = priority;
+}
+
+// Whether a blocked process can never be woken: it waits for a resource with no free units whose
+// holders are all stuck too. A process already on the search path counts as stuck, which is what
+// closes a cycle; a holder that is ready or running breaks it.
+int isStuck(PCB *process) {
+    if (process->state != BLOCKED || process->waiting_on < 0) {
+        return 0;
+    }
+    if (process->deadlock_mark == deadlock_generation) {
+        return process->deadlock_stuck;
+    }
+    process->deadlock_mark = deadlock_generation;
+    process->deadlock_stuck = 1;
+    ResourceEntry *resource = &resources[process->waiting_on];
+    int stuck = resource->holder_count > 0;
+    for (int i = 0; stuck && i < resource->holder_count; i++) {
+        stuck = isStuck(resource->holders[i]);
+    }
+    process->deadlock_stuck = stuck;
+    return stuck;
+}
+
+// Check the wait-for edges a process just added by blocking; only its holders are searched
+void detectDeadlock(PCB *pcb) {
+    deadlock_generation++;
+    if (!isStuck(pcb)) {
+        return;
+    }
+    if (deadlock_pending_count == deadlock_pending_capacity) {
+        deadlock_pending_capacity = deadlock_pending_capacity == 0 ? 8 : deadlock_pending_capacity * 2;
+        deadlock_pending = realloc(deadlock_pending, deadlock_pending_capacity * sizeof(int));
+        if (deadlock_pending == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    deadlock_pending[deadlock_pending_count++] = pcb->process_id;
+}
+
+// Function to handle semWait: take a unit of the resource or block until one is handed over
+void semWait(int id, PCB *pcb) {
+    ResourceEntry *resource = &resources[id];
+    if (sem_trywait(&resource->lock) == 0) {
+        addHolder(resource, pcb);
+        return; // Successfully acquired the semaphore
+    }
+    pcb->state = BLOCKED;
+    pcb->waiting_on = id;
+    pcb->blocked_at = current_time + tick_in_progress;
+    pcb->blocked_since = wait_sequence++;
+    strcpy(pcb->blocked_resource, internName(resource->name));
+    removePCB(&running_queue, pcb);
+    pushHeap(&resource->waiters, pcb);
+    if (priority_inheritance) {
+        inheritPriority(id, pcb->priority);
+    }
+    detectDeadlock(pcb);
+}
+
+// Function to handle semSignal: give a unit back, straight to the first waiter if there is one
+void semSignal(int id, PCB *pcb) {
+    ResourceEntry *resource = &resources[id];
+    removeHolder(resource, pcb);
+    releaseUnit(resource);
+    if (priority_inheritance) {
+        restorePriority(pcb);
+    }
+}
+
+// Memory index of a variable slot of a process
+int varAddress(PCB *pcb, int slot) {
+    return pcb->lower_memory_bound + slot;
+}
+
+// Look a name up in the process symbol table, returns the slot or -1
+int lookupVariable(PCB *pcb, int name) {
+    for (int i = 0; i < pcb->var; i++) {
+        if (pcb->var_names[i] == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Resolve an operand to a variable slot and cache it in the instruction. The text is shared, so
+// the cache is only a hint: it is checked against this process's symbol table before use.
+int resolveSlot(PCB *pcb, int name, signed char *cached) {
+    if (*cached < 0 || *cached >= pcb->var || pcb->var_names[(int)*cached] != name) {
+        *cached = lookupVariable(pcb, name);
+    }
+    return *cached;
+}
+
+// Value of an operand: the variable it names if bound, otherwise the literal
+const char *operandValue(PCB *pcb, int name, signed char *cached) {
+    int slot = resolveSlot(pcb, name, cached);
+    return slot < 0 ? internName(name) : wordValue(varAddress(pcb, slot));
+}
+
+// Memory index of a variable, binding the name to the next free slot on first use; -1 if there is no space left
+int bindVariable(PCB *pcb, int var, signed char *cached) {
+    int slot = resolveSlot(pcb, var, cached);
+    if (slot < 0) {
+        if (pcb->var >= INPUT_SPACE_PER_PROCESS) {
+            TRACE(TRACE_SUMMARY, "No space left for the variable '%s'.\n", internName(var));
+            return -1;
+        }
+        slot = pcb->var++;
+        pcb->var_names[slot] = var;
+        word_tag[varAddress(pcb, slot)] = WORD_VARIABLE;
+        word_name[varAddress(pcb, slot)] = var;
+        *cached = slot;
+    }
+    return varAddress(pcb, slot);
+}
+
+// Store a value in a variable
+void storeVariable(PCB *pcb, int var, signed char *cached, const char *value) {
+    int address = bindVariable(pcb, var, cached);
+    if (address >= 0) {
+        setWordValue(address, value);
+    }
+}
+
+// Integer value of a variable, 0 if it is unbound. Text is parsed on first use and the
+// integer kept in the memory word until the variable is assigned text again.
+long long integerValue(PCB *pcb, int name, signed char *cached) {
+    int slot = resolveSlot(pcb, name, cached);
+    if (slot < 0) {
+        return 0;
+    }
+    int address = varAddress(pcb, slot);
+    if (word_state[address] == WORD_TEXT) {
+        word_int[address] = atoll(wordValue(address));
+        word_state[address] = WORD_PARSED;
+    }
+    return word_int[address];
+}
+
+// Second operand of an arithmetic or compare instruction: its literal, or the variable it names
+long long integerOperand(PCB *pcb, Instruction *ins) {
+    return ins->literal ? ins->imm : integerValue(pcb, ins->arg2, &ins->slot2);
+}
+
+// Store an integer in a variable. Only the integer is written; wordValue renders the text when it is read.
+void storeInteger(PCB *pcb, int var, signed char *cached, long long value) {
+    int address = bindVariable(pcb, var, cached);
+    if (address >= 0) {
+        word_int[address] = value;
+        word_state[address] = WORD_INTEGER;
+        markDirty(address);
+    }
+}
+
+// Append a value to the pre-recorded input stream
+void addInput(const char *value) {
+    char **grown = realloc(input_stream, (input_count + 1) * sizeof(char *));
+    if (grown == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    input_stream = grown;
+    input_stream[input_count++] = strdup(value);
+}
+
+// Read the value for `assign var input`, from the input stream when one is available
+void readInput(const char *var, char *data) {
+    if (input_next < input_count) {
+        strcpy(data, input_stream[input_next++]);
+        TRACE(TRACE_EVENT, "Input for %s: %s\n", var, data);
+        return;
+    }
+    if (batch_mode) {
+        fprintf(stderr, "Error: input stream exhausted while reading '%s'.\n", var);
+        exit(EXIT_FAILURE);
+    }
+    printf("Please enter a value for %s: ", var);
+    fflush(stdout);
+    scanf("%255s", data);
+}
+
+// How readFile and writeFile reach files
+enum FsMode {
+    FS_CACHED, // in-memory file cache, dirty files written back in batches
+    FS_SYNC    // every access goes straight to the host file
+};
+
+// A cached file
+typedef struct VfsFile {
+    char *path;    // as the program names it
+    char *data;    // contents, NULL if the file does not exist
+    size_t length;
+    int dirty;     // changed since it was last written back
+} VfsFile;
+
+enum FsMode fs_mode = FS_CACHED;
+int fs_writeback_interval = 0; // ticks between write-backs, 0 = only at exit
+const char *fs_root = ".";     // host directory behind the cache
+int fs_preload = 0;            // read every file in fs_root into the cache at startup
+VfsFile *vfs_files = NULL;
+int vfs_count = 0;
+int vfs_capacity = 0;
+int *vfs_table = NULL;         // open-addressing index into vfs_files by path hash
+int vfs_table_size = 0;
+unsigned long vfs_reads = 0, vfs_writes = 0, vfs_host_reads = 0, vfs_write_backs = 0;
+
+// Host path of a file the programs name by `path`
+void hostPath(const char *path, char *out, size_t size) {
+    if (path[0] == '/' || strcmp(fs_root, ".") == 0) {
+        snprintf(out, size, "%s", path);
+    } else {
+        snprintf(out, size, "%s/%s", fs_root, path);
+    }
+}
+
+// Read a whole host file; returns NULL if it cannot be opened
+char *readHostFile(const char *path, size_t *length) {
+    char host[512];
+    hostPath(path, host, sizeof(host));
+    FILE *file = fopen(host, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    size_t capacity = 256, used = 0, got;
+    char *data = malloc(capacity);
+    if (data == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    while ((got = fread(data + used, 1, capacity - used, file)) > 0) {
+        used += got;
+        if (used == capacity) {
+            capacity *= 2;
+            char *grown = realloc(data, capacity);
+            if (grown == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+    }
+    fclose(file);
+    vfs_host_reads++;
+    *length = used;
+    return data;
+}
+
+// Cached file for a path, added if it is new. With `read_through` a new entry is filled from the host.
+VfsFile *vfsOpen(const char *path, int read_through) {
+    if (vfs_count * 2 >= vfs_table_size) {
+        int size = vfs_table_size == 0 ? 64 : vfs_table_size * 2;
+        int *table = malloc(size * sizeof(int));
+        if (table == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        memset(table, -1, size * sizeof(int));
+        for (int i = 0; i < vfs_count; i++) {
+            unsigned int h = hashString(vfs_files[i].path) & (size - 1);
+            while (table[h] >= 0) {
+                h = (h + 1) & (size - 1);
+            }
+            table[h] = i;
+        }
+        free(vfs_table);
+        vfs_table = table;
+        vfs_table_size = size;
+    }
+
+    unsigned int h = hashString(path) & (vfs_table_size - 1);
+    while (vfs_table[h] >= 0) {
+        if (strcmp(vfs_files[vfs_table[h]].path, path) == 0) {
+            return &vfs_files[vfs_table[h]];
+        }
+        h = (h + 1) & (vfs_table_size - 1);
+    }
+
+    if (vfs_count == vfs_capacity) {
+        vfs_capacity = vfs_capacity == 0 ? 16 : vfs_capacity * 2;
+        vfs_files = realloc(vfs_files, vfs_capacity * sizeof(VfsFile));
+        if (vfs_files == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    VfsFile *file = &vfs_files[vfs_count];
+    file->path = strdup(path);
+    file->length = 0;
+    file->data = read_through ? readHostFile(path, &file->length) : NULL;
+    file->dirty = 0;
+    vfs_table[h] = vfs_count++;
+    return file;
+}
+
+// Write every dirty cached file back to the host
+void vfsWriteBack() {
+    int written = 0;
+    for (int i = 0; i < vfs_count; i++) {
+        VfsFile *cached = &vfs_files[i];
+        if (!cached->dirty) {
+            continue;
+        }
+        char host[512];
+        hostPath(cached->path, host, sizeof(host));
+        FILE *file = fopen(host, "wb");
+        if (file == NULL || fwrite(cached->data, 1, cached->length, file) != cached->length) {
+            TRACE(TRACE_SUMMARY, "Warning: could not write back '%s'.\n", host);
+        }
+        if (file != NULL) {
+            fclose(file);
+        }
+        cached->dirty = 0;
+        written++;
+    }
+    vfs_write_backs += written;
+    if (written > 0) {
+        TRACE(TRACE_EVENT, "Wrote back %d cached files.\n", written);
+    }
+}
+
+// Read every regular file in fs_root into the cache
+void vfsPreload() {
+    DIR *dir = opendir(fs_root);
+    if (dir == NULL) {
+        fprintf(stderr, "Error: Could not open directory '%s'.\n", fs_root);
+        exit(EXIT_FAILURE);
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char host[512];
+        struct stat info;
+        hostPath(entry->d_name, host, sizeof(host));
+        if (stat(host, &info) == 0 && S_ISREG(info.st_mode)) {
+            vfsOpen(entry->d_name, 1);
+        }
+    }
+    closedir(dir);
+}
+
+void freeVfs() {
+    for (int i = 0; i < vfs_count; i++) {
+        free(vfs_files[i].path);
+        free(vfs_files[i].data);
+    }
+    free(vfs_files);
+    free(vfs_table);
+    vfs_files = NULL;
+    vfs_table = NULL;
+    vfs_count = vfs_capacity = vfs_table_size = 0;
+}
+
+// Read the first line of a file into `out` (at most size - 1 bytes, newline kept).
+// Returns 0, -1 if the file does not exist, or -2 if it is empty.
+int fsReadLine(const char *path, char *out, size_t size) {
+    if (fs_mode == FS_SYNC) {
+        char host[512];
+        hostPath(path, host, sizeof(host));
+        FILE *file = fopen(host, "r");
+        if (file == NULL) {
+            return -1;
+        }
+        int status = fgets(out, size, file) == NULL ? -2 : 0;
+        fclose(file);
+        return status;
+    }
+    VfsFile *file = vfsOpen(path, 1);
+    vfs_reads++;
+    if (file->data == NULL) {
+        return -1;
+    }
+    if (file->length == 0) {
+        return -2;
+    }
+    size_t length = 0;
+    while (length < size - 1 && length < file->length && (length == 0 || file->data[length - 1] != '\n')) {
+        length++;
+    }
+    memcpy(out, file->data, length);
+    out[length] = '\0';
+    return 0;
+}
+
+// Read the first whitespace-separated word of a file into `out` (MAX_VALUE_LENGTH bytes at most).
+// Returns 1 if there was one.
+int fsReadWord(const char *path, char *out) {
+    if (fs_mode == FS_SYNC) {
+        char host[512];
+        hostPath(path, host, sizeof(host));
+        FILE *file = fopen(host, "r");
+        if (file == NULL) {
+            return 0;
+        }
+        int found = fscanf(file, "%255s", out) == 1;
+        fclose(file);
+        return found;
+    }
+    VfsFile *file = vfsOpen(path, 1);
+    vfs_reads++;
+    if (file->data == NULL) {
+        out[0] = '\0';
+        return 0;
+    }
+    size_t start = 0, length = 0;
+    while (start < file->length && strchr(" \t\n\v\f\r", file->data[start]) != NULL) {
+        start++;
+    }
+    while (start + length < file->length && length < MAX_VALUE_LENGTH && strchr(" \t\n\v\f\r", file->data[start + length]) == NULL) {
+        length++;
+    }
+    memcpy(out, file->data + start, length);
+    out[length] = '\0';
+    return length > 0;
+}
+
+// Replace the contents of a file
+void fsWrite(const char *path, const char *data) {
+    if (fs_mode == FS_SYNC) {
+        char host[512];
+        hostPath(path, host, sizeof(host));
+        FILE *file = fopen(host, "w");
+        if (file != NULL) {
+            fprintf(file, "%s", data);
+            fclose(file);
+        }
+        return;
+    }
+    VfsFile *file = vfsOpen(path, 0);
+    vfs_writes++;
+    file->length = strlen(data);
+    char *grown = realloc(file->data, file->length + 1);
+    if (grown == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    file->data = grown;
+    memcpy(file->data, data, file->length + 1);
+    file->dirty = 1;
+}
+
+// Nanoseconds elapsed on the monotonic clock since `start`
+long long elapsedNs(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000000LL + (now.tv_nsec - start->tv_nsec);
+}
+
+// Enter a real I/O section guarded by a resource's semaphore, which the I/O workers share. In threaded
+// mode the simulation lock is dropped meanwhile, so operands must already be copied out of memory.
+// Returns how long the semaphore was waited for.
+long long beginIO(enum Resource resource) {
+    if (threaded) {
+        pthread_mutex_unlock(&kernel_lock);
+    }
+    if (sem_trywait(resource_mutexes[resource]) == 0) {
+        return 0;
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (sem_wait(resource_mutexes[resource]) != 0 && errno == EINTR) {
+    }
+    long long waited = elapsedNs(&start);
+    return waited > 0 ? waited : 1;
+}
+
+// Leave an I/O section started by beginIO
+void endIO(enum Resource resource, long long waited) {
+    sem_post(resource_mutexes[resource]);
+    if (threaded) {
+        pthread_mutex_lock(&kernel_lock);
+    }
+    if (waited > 0) {
+        contended_io++;
+        io_wait_ns += waited;
+    }
+}
+
+// Carry out the host side of a file instruction: `value` is the data to write, or receives what was read.
+// Returns the read status: fsReadLine's for assign-readFile, whether a word was found for readFile.
+int performFileIO(unsigned char opcode, const char *name, char *value) {
+    if (replaying) {
+        value[0] = '\0'; // the result comes from the log
+        return 0;
+    }
+    switch (opcode) {
+        case OP_ASSIGN_READFILE:
+            value[0] = '\0';
+            return fsReadLine(name, value, MAX_VALUE_LENGTH + 1);
+        case OP_READ_FILE:
+            value[0] = '\0';
+            return fsReadWord(name, value);
+        default:
+            fsWrite(name, value);
+            return 0;
+    }
+}
+
+// Carry out the host side of an output or file instruction. `name` and `value` are the operands of
+// printFromTo, and for print `value` is the text. Returns performFileIO's status.
+int performHostIO(unsigned char opcode, const char *name, char *value) {
+    if (opcode == OP_PRINT) {
+        fprintf(program_output, "%s\n", value);
+        return 0;
+    }
+    if (opcode == OP_PRINT_FROM_TO) {
+        int end = atoi(value);
+        for (int i = atoi(name); i <= end; i++) {
+            fprintf(program_output, "%d\n", i);
+        }
+        return 0;
+    }
+    return performFileIO(opcode, name, value);
+}
+
+// Host side of an output or file instruction of the running process, unless its thread already did
+// it before its turn; then a read gets the result that was fetched. Returns performFileIO's status.
+int hostIO(PCB *pcb, unsigned char opcode, const char *name, char *value) {
+    ProcessThread *thread = pcb->thread;
+    if (thread != NULL && thread->prefetched) {
+        thread->prefetched = 0;
+        strcpy(value, thread->io_value);
+        return thread->io_status;
+    }
+    enum Resource resource = opcode == OP_PRINT || opcode == OP_PRINT_FROM_TO ? RESOURCE_USER_OUTPUT : RESOURCE_FILE;
+    long long waited = beginIO(resource);
+    int status = performHostIO(opcode, name, value);
+    endIO(resource, waited);
+    return status;
+}
+
+// Store the result of a completed file read in the process's variable
+void finishFileRead(PCB *pcb, Instruction *ins, const char *name, char *value, int status) {
+    if (ins->opcode == OP_READ_FILE || ins->opcode == OP_ASSIGN_READFILE) {
+        exchangeValue(RECORD_FILE_READ, &status, value);
+    }
+    if (ins->opcode == OP_READ_FILE) {
+        if (status) {
+            storeVariable(pcb, ins->arg2, &ins->slot2, value);
+        }
+    } else if (ins->opcode == OP_ASSIGN_READFILE) {
+        if (status == -1) {
+            TRACE(TRACE_SUMMARY, "Error: Could not open file '%s'.\n", name);
+        } else if (status == -2) {
+            TRACE(TRACE_SUMMARY, "Error: Could not read from file '%s'.\n", name);
+        } else {
+            // Remove newline character if present
+            value[strcspn(value, "\n")] = '\0';
+            storeVariable(pcb, ins->arg1, &ins->slot1, value);
+        }
+    }
+}
+
+// Body of an I/O worker: carry out queued file instructions in submission order
+void *ioWorker(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&io_lock);
+    for (;;) {
+        while (io_pending_front == NULL && !io_stopping) {
+            pthread_cond_wait(&io_submitted, &io_lock);
+        }
+        IORequest *request = io_pending_front;
+        if (request == NULL) {
+            break;
+        }
+        io_pending_front = request->next;
+        if (io_pending_front == NULL) {
+            io_pending_rear = NULL;
+        }
+        pthread_mutex_unlock(&io_lock);
+
+        // The file semaphore serializes the workers on the file cache
+        while (sem_wait(&file_mutex) != 0 && errno == EINTR) {
+        }
+        int status = performFileIO(request->opcode, request->name, request->value);
+        sem_post(&file_mutex);
+
+        pthread_mutex_lock(&io_lock);
+        request->status = status;
+        request->done = 1;
+        pthread_cond_broadcast(&io_finished);
+    }
+    pthread_mutex_unlock(&io_lock);
+    return NULL;
+}
+
+void startIOWorkers() {
+    io_workers = malloc(io_worker_count * sizeof(pthread_t));
+    for (int i = 0; i < io_worker_count; i++) {
+        if (pthread_create(&io_workers[i], NULL, ioWorker, NULL) != 0) {
+            perror("Failed to create I/O worker");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// Let the workers finish what is queued, then join them
+void stopIOWorkers() {
+    if (io_workers == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&io_lock);
+    io_stopping = 1;
+    pthread_cond_broadcast(&io_submitted);
+    pthread_mutex_unlock(&io_lock);
+    for (int i = 0; i < io_worker_count; i++) {
+        pthread_join(io_workers[i], NULL);
+    }
+    free(io_workers);
+    io_workers = NULL;
+}
+
+// Hand a file instruction to the I/O workers; the process waits off the CPU until it completes.
+// `value` is the data to write.
+void submitIO(PCB *pcb, Instruction *ins, const char *name, const char *value) {
+    if (io_workers == NULL) {
+        startIOWorkers();
+    }
+    IORequest *request = calloc(1, sizeof(IORequest));
+    if (request == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    request->process = pcb;
+    request->ins = ins;
+    request->opcode = ins->opcode;
+    strcpy(request->name, name);
+    strcpy(request->value, value);
+    request->issued_at = current_time + tick_in_progress;
+    request->complete_at = request->issued_at + io_latency;
+    io_requests++;
+
+    pcb->io = request;
+    pcb->state = WAITING;
+    removePCB(&running_queue, pcb);
+    enqueue(&io_wait_queue, pcb);
+
+    pthread_mutex_lock(&io_lock);
+    if (io_pending_rear == NULL) {
+        io_pending_front = request;
+    } else {
+        io_pending_rear->next = request;
+    }
+    io_pending_rear = request;
+    pthread_cond_signal(&io_submitted);
+    pthread_mutex_unlock(&io_lock);
+}
+
+// Instructions are dispatched through a table of handler addresses (computed goto, "threaded code")
+// when the compiler supports it, otherwise through a switch. Build with -DSWITCH_DISPATCH to force the switch.
+// A handler ends with NEXT when the following instruction may run straight after it, or with DONE.
+#if defined(__GNUC__) && !defined(SWITCH_DISPATCH)
+#define THREADED_DISPATCH
+#define DISPATCH(opcode) goto *handlers[opcode];
+#define HANDLE(opcode) handle_##opcode:
+#define NEXT goto next
+#else
+#define DISPATCH(opcode) switch (opcode)
+#define HANDLE(opcode) case opcode:
+#define NEXT break
+#endif
+#define DONE goto done
+
+volatile sig_atomic_t checkpoint_requested = 0; // set by SIGUSR1, also ends a chain of instructions
+
+// Instructions that touch nothing outside the process's own variables: no resources, I/O, output or
+// input. Only these run chained, since nothing else can observe when they ran.
+const unsigned char chainable[OPCODE_COUNT] = {
+    [OP_UNKNOWN] = 1, [OP_ASSIGN] = 1, [OP_DECLARE_RESOURCE] = 1, [OP_ADD] = 1, [OP_SUB] = 1, [OP_MUL] = 1,
+    [OP_CMP] = 1, [OP_JUMP] = 1, [OP_JUMP_EQ] = 1, [OP_JUMP_NE] = 1, [OP_JUMP_LT] = 1, [OP_JUMP_LE] = 1,
+    [OP_JUMP_GT] = 1, [OP_JUMP_GE] = 1, [OP_LABEL] = 1,
+};
+
+// Charge the process running on a core for one tick and move it to its next instruction
+void chargeTick(Core *core, PCB *process) {
+    process->program_counter++;
+    core->busy_ticks++;
+    core->slice_left--;
+    process->ticks_run++;
+    process->level_ticks++;
+    metrics[process->process_id - 1].cpu_ticks++;
+}
+
+// Take a jump: continue at a line of the program. The tick then advances the counter past it,
+// so it is left one short.
+void jumpTo(PCB *pcb, Instruction *ins) {
+    pcb->program_counter = images[pcb->image].text_base + ins->imm - 1;
+}
+
+// Execute a decoded instruction on behalf of the process running on a core. Up to `chain` chainable
+// instructions that follow it in the same quantum run straight after it, each charged a tick of its
+// own; the caller charges the last instruction. Returns how many followed.
+int executeInstruction(Core *core, PCB *pcb, Instruction *ins, int chain) {
+    char name[MAX_VALUE_LENGTH + 1], value[MAX_VALUE_LENGTH + 1];
+    ProgramImage *image = &images[pcb->image];
+    int chained = 0;
+#ifdef THREADED_DISPATCH
+    static void *handlers[OPCODE_COUNT] = {
+        [OP_MALFORMED] = &&handle_OP_MALFORMED,
+        [OP_UNKNOWN] = &&handle_OP_UNKNOWN,
+        [OP_SEM_WAIT] = &&handle_OP_SEM_WAIT,
+        [OP_SEM_SIGNAL] = &&handle_OP_SEM_SIGNAL,
+        [OP_ASSIGN] = &&handle_OP_ASSIGN,
+        [OP_ASSIGN_INPUT] = &&handle_OP_ASSIGN_INPUT,
+        [OP_ASSIGN_READFILE] = &&handle_OP_ASSIGN_READFILE,
+        [OP_PRINT] = &&handle_OP_PRINT,
+        [OP_PRINT_FROM_TO] = &&handle_OP_PRINT_FROM_TO,
+        [OP_WRITE_FILE] = &&handle_OP_WRITE_FILE,
+        [OP_READ_FILE] = &&handle_OP_READ_FILE,
+        [OP_DECLARE_RESOURCE] = &&handle_OP_DECLARE_RESOURCE,
+        [OP_ADD] = &&handle_OP_ADD,
+        [OP_SUB] = &&handle_OP_SUB,
+        [OP_MUL] = &&handle_OP_MUL,
+        [OP_CMP] = &&handle_OP_CMP,
+        [OP_JUMP] = &&handle_OP_JUMP,
+        [OP_JUMP_EQ] = &&handle_OP_JUMP_EQ,
+        [OP_JUMP_NE] = &&handle_OP_JUMP_NE,
+        [OP_JUMP_LT] = &&handle_OP_JUMP_LT,
+        [OP_JUMP_LE] = &&handle_OP_JUMP_LE,
+        [OP_JUMP_GT] = &&handle_OP_JUMP_GT,
+        [OP_JUMP_GE] = &&handle_OP_JUMP_GE,
+        [OP_LABEL] = &&handle_OP_LABEL,
+    };
+#endif
+#ifndef THREADED_DISPATCH
+    for (;;) {
+#endif
+    DISPATCH(ins->opcode) {
+        HANDLE(OP_SEM_WAIT)
+            if (ins->resource != RESOURCE_NONE) {
+                semWait(ins->resource, pcb);
+            }
+            DONE;
+
+        HANDLE(OP_SEM_SIGNAL)
+            if (ins->resource != RESOURCE_NONE) {
+                semSignal(ins->resource, pcb);
+            }
+            DONE;
+
+        HANDLE(OP_ASSIGN)
+            storeVariable(pcb, ins->arg1, &ins->slot1, internName(ins->arg2));
+            NEXT;
+
+        HANDLE(OP_ASSIGN_INPUT) {
+            strcpy(name, internName(ins->arg1));
+            if (!replaying) {
+                long long waited = beginIO(RESOURCE_USER_INPUT);
+                readInput(name, value);
+                endIO(RESOURCE_USER_INPUT, waited);
+            }
+            exchangeValue(RECORD_INPUT, NULL, value);
+            storeVariable(pcb, ins->arg1, &ins->slot1, value);
+            DONE;
+        }
+
+        HANDLE(OP_ASSIGN_READFILE) {
+            strcpy(name, operandValue(pcb, ins->arg2, &ins->slot2));
+            if (io_mode == IO_ASYNC) {
+                submitIO(pcb, ins, name, "");
+                DONE;
+            }
+
+            // Read the first line of the file
+            int status = hostIO(pcb, ins->opcode, name, value);
+            finishFileRead(pcb, ins, name, value, status);
+            DONE;
+        }
+
+        HANDLE(OP_PRINT)
+            if (resolveSlot(pcb, ins->arg1, &ins->slot1) >= 0) {
+                strcpy(value, wordValue(varAddress(pcb, ins->slot1)));
+                hostIO(pcb, ins->opcode, name, value);
+            }
+            DONE;
+
+        HANDLE(OP_PRINT_FROM_TO) {
+            strcpy(name, operandValue(pcb, ins->arg1, &ins->slot1));
+            strcpy(value, operandValue(pcb, ins->arg2, &ins->slot2));
+            hostIO(pcb, ins->opcode, name, value);
+            DONE;
+        }
+
+        HANDLE(OP_WRITE_FILE) {
+            strcpy(name, operandValue(pcb, ins->arg1, &ins->slot1));
+            strcpy(value, operandValue(pcb, ins->arg2, &ins->slot2));
+            if (io_mode == IO_ASYNC) {
+                submitIO(pcb, ins, name, value);
+                DONE;
+            }
+            hostIO(pcb, ins->opcode, name, value);
+            DONE;
+        }
+
+        HANDLE(OP_READ_FILE) {
+            strcpy(name, operandValue(pcb, ins->arg1, &ins->slot1));
+            if (io_mode == IO_ASYNC) {
+                submitIO(pcb, ins, name, "");
+                DONE;
+            }
+            int found = hostIO(pcb, ins->opcode, name, value);
+            finishFileRead(pcb, ins, name, value, found);
+            DONE;
+        }
+
+        // Arithmetic wraps around on overflow; an unbound variable counts as 0
+        HANDLE(OP_ADD) {
+            unsigned long long left = integerValue(pcb, ins->arg1, &ins->slot1);
+            unsigned long long right = integerOperand(pcb, ins);
+            storeInteger(pcb, ins->arg1, &ins->slot1, (long long)(left + right));
+            NEXT;
+        }
+
+        HANDLE(OP_SUB) {
+            unsigned long long left = integerValue(pcb, ins->arg1, &ins->slot1);
+            unsigned long long right = integerOperand(pcb, ins);
+            storeInteger(pcb, ins->arg1, &ins->slot1, (long long)(left - right));
+            NEXT;
+        }
+
+        HANDLE(OP_MUL) {
+            unsigned long long left = integerValue(pcb, ins->arg1, &ins->slot1);
+            unsigned long long right = integerOperand(pcb, ins);
+            storeInteger(pcb, ins->arg1, &ins->slot1, (long long)(left * right));
+            NEXT;
+        }
+
+        HANDLE(OP_CMP) {
+            long long left = integerValue(pcb, ins->arg1, &ins->slot1);
+            long long right = integerOperand(pcb, ins);
+            pcb->condition = (left > right) - (left < right);
+            NEXT;
+        }
+
+        HANDLE(OP_JUMP)
+            jumpTo(pcb, ins);
+            NEXT;
+
+        HANDLE(OP_JUMP_EQ)
+            if (pcb->condition == 0) {
+                jumpTo(pcb, ins);
+            }
+            NEXT;
+
+        HANDLE(OP_JUMP_NE)
+            if (pcb->condition != 0) {
+                jumpTo(pcb, ins);
+            }
+            NEXT;
+
+        HANDLE(OP_JUMP_LT)
+            if (pcb->condition < 0) {
+                jumpTo(pcb, ins);
+            }
+            NEXT;
+
+        HANDLE(OP_JUMP_LE)
+            if (pcb->condition <= 0) {
+                jumpTo(pcb, ins);
+            }
+            NEXT;
+
+        HANDLE(OP_JUMP_GT)
+            if (pcb->condition > 0) {
+                jumpTo(pcb, ins);
+            }
+            NEXT;
+
+        HANDLE(OP_JUMP_GE)
+            if (pcb->condition >= 0) {
+                jumpTo(pcb, ins);
+            }
+            NEXT;
+
+        HANDLE(OP_MALFORMED)
+            DONE;
+
+        HANDLE(OP_UNKNOWN)
+        HANDLE(OP_DECLARE_RESOURCE)
+        HANDLE(OP_LABEL)
+            NEXT;
+    }
+#ifdef THREADED_DISPATCH
+next:
+#endif
+    // Run on into the next instruction while it is chainable and neither the chain, the quantum
+    // nor the program ends with this one
+    if (chained == chain || core->slice_left <= 1 || checkpoint_requested ||
+        (int)pcb->program_counter + 1 >= image->text_base + image->size ||
+        !chainable[decoded[pcb->program_counter + 1].opcode]) {
+        DONE;
+    }
+    chargeTick(core, pcb);
+    instructions_executed++;
+    chained++;
+    ins = &decoded[pcb->program_counter];
+#ifdef THREADED_DISPATCH
+    DISPATCH(ins->opcode)
+#else
+    }
+#endif
+done:
+    return chained;
+}
+
+// Wait until the wall clock reaches the end of the next paced tick.
+// Deadlines are absolute on the monotonic clock so sleeps do not accumulate drift;
+// after a long stall (e.g. waiting for input) the schedule restarts instead of racing to catch up.
+void paceTick() {
+    static struct timespec deadline;
+    static int started = 0;
+
+    if (pacing_mode == PACE_MAX) {
+        return;
+    }
+    long tick_ns = (pacing_mode == PACE_DEMO ? 1000000L : tick_length_us) * 1000L;
+    fflush(stdout); // a paced run is watched live
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long late_ns = (now.tv_sec - deadline.tv_sec) * 1000000000LL + (now.tv_nsec - deadline.tv_nsec);
+    if (!started || late_ns > tick_ns) {
+        deadline = now;
+        started = 1;
+    }
+
+    deadline.tv_nsec += tick_ns;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+}
+
+// Time of the next pending event after an idle tick at `time`: a release or an I/O completion
+int nextEventTime(int time) {
+    int next = INT_MAX;
+    PCB *next_release = peekHeap(&started_queue);
+    if (next_release != NULL) {
+        next = next_release->release_time;
+    }
+    if (io_latency >= 0) {
+        for (PCB *process = io_wait_queue.front; process != NULL; process = process->next) {
+            if ((int)process->io->complete_at < next) {
+                next = process->io->complete_at;
+            }
+        }
+    }
+    return next > time && next != INT_MAX ? next : time + 1;
+}
+
+// Make a newly loaded process ready; the time since its release, spent waiting for
+// admission or for memory, counts as ready wait
+void makeAdmitted(PCB *process) {
+    if (policy->on_arrival != NULL) {
+        policy->on_arrival(process);
+    }
+    makeReady(process);
+    process->ready_since = process->release_time;
+}
+
+// Admit a released process: load it into memory and make it ready, or wait for memory
+void admitProcess(PCB *process) {
+    if (loadProgram(process) < 0) {
+        TRACE(TRACE_EVENT, "Process ID: %d is waiting for memory.\n", process->process_id);
+        enqueue(&memory_wait_queue, process);
+        return;
+    }
+    makeAdmitted(process);
+}
+
+// Retry admitting processes waiting for memory, in arrival order
+void admitWaiting() {
+    PCB *process = memory_wait_queue.front;
+    while (process != NULL) {
+        PCB *next = process->next;
+        if (loadProgram(process) == 0) {
+            makeAdmitted(process);
+        }
+        process = next;
+    }
+}
+
+// Terminate a process, reclaiming its memory for waiting arrivals
+void terminateProcess(PCB *process, int time) {
+    noteDecision(RECORD_TERMINATE, time, process, 0);
+    process->state = TERMINATED;
+    process->end_time = time;
+    TRACE(TRACE_EVENT, "Process ID: %d terminated.\n", process->process_id);
+    removePCB(&running_queue, process);
+    if (policy->on_terminate != NULL) {
+        policy->on_terminate(process);
+    }
+    metrics[process->process_id - 1].completion = time;
+    for (int i = 0; i < resource_count; i++) {
+        while (removeHolder(&resources[i], process)) {
+            // it exits still holding the unit, which stays taken
+        }
+    }
+    unloadProgram(process);
+    processes[process->process_id - 1] = NULL;
+    if (process->thread == NULL) {
+        free(process); // a threaded process is freed once its thread is joined
+    }
+    terminated_count++;
+    admitWaiting();
+}
+
+// Round robin: first come, first served within a quantum
+PCB *pickFront(Queue *ready) {
+    return ready->front;
+}
+
+// The process in a ready queue that the policy's comparison ranks first, earliest on ties
+PCB *pickBest(Queue *ready) {
+    PCB *best = ready->front;
+    for (PCB *process = ready->front; process != NULL; process = process->next) {
+        if (policy->compare(process, best) < 0) {
+            best = process;
+        }
+    }
+    return best;
+}
+
+unsigned int quantumSlice(PCB *process) {
+    return process->quantum;
+}
+
+unsigned int unlimitedSlice(PCB *process) {
+    (void)process;
+    return UINT_MAX;
+}
+
+// MLFQ: each level down doubles the quantum
+unsigned int mlfqSlice(PCB *process) {
+    return process->quantum << process->level;
+}
+
+int compareLevel(PCB *a, PCB *b) {
+    return a->level - b->level;
+}
+
+// Periodically move every process back to the top level so long jobs are not starved
+PCB *pickMlfq(Queue *ready) {
+    if (current_time - mlfq_last_boost >= MLFQ_BOOST_INTERVAL) {
+        mlfq_last_boost = current_time;
+        for (int i = 0; i < program_count; i++) {
+            if (processes[i] != NULL) {
+                processes[i]->level = 0;
+                processes[i]->level_ticks = 0;
+            }
+        }
+    }
+    return pickBest(ready);
+}
+
+void mlfqArrival(PCB *process) {
+    process->level = 0;
+    process->level_ticks = 0;
+}
+
+// Demote a process once it has used its allotment at its level, whether or not it blocked
+void mlfqCharge(PCB *process) {
+    if (process->level_ticks >= mlfqSlice(process) && process->level < MLFQ_LEVELS - 1) {
+        process->level++;
+        process->level_ticks = 0;
+    }
+}
+
+// Shortest remaining time: fewest instructions left runs first. The remaining count is the
+// program length minus the instructions executed, so it is only an estimate once a program
+// jumps backwards: a loop that has run longer than its program looks nearly done.
+int compareRemaining(PCB *a, PCB *b) {
+    return (a->program_size - (int)a->ticks_run) - (b->program_size - (int)b->ticks_run);
+}
+
+// Priority, improved by one level for every aging_interval ticks spent waiting when aging is on
+int effectivePriority(PCB *process) {
+    if (aging_interval > 0 && process->state == READY) {
+        int waited = current_time > (int)process->ready_since ? current_time - (int)process->ready_since : 0;
+        return process->priority - waited / aging_interval;
+    }
+    return process->priority;
+}
+
+int comparePriority(PCB *a, PCB *b) {
+    return effectivePriority(a) - effectivePriority(b);
+}
+
+// Tickets held in the lottery: priority 0 holds PRIORITY_LEVELS tickets, the lowest priority holds one
+unsigned int lotteryTickets(PCB *process) {
+    int priority = process->priority < 0 ? 0 : process->priority >= PRIORITY_LEVELS ? PRIORITY_LEVELS - 1 : process->priority;
+    return PRIORITY_LEVELS - priority;
+}
+
+// Lottery: draw a ticket uniformly, xorshift32 keeps runs reproducible for a given seed
+PCB *pickLottery(Queue *ready) {
+    unsigned int total = 0;
+    for (PCB *process = ready->front; process != NULL; process = process->next) {
+        total += lotteryTickets(process);
+    }
+    if (total == 0) {
+        return NULL;
+    }
+    lottery_state ^= lottery_state << 13;
+    lottery_state ^= lottery_state >> 17;
+    lottery_state ^= lottery_state << 5;
+    unsigned int winner = lottery_state % total;
+    for (PCB *process = ready->front; process != NULL; process = process->next) {
+        if (winner < lotteryTickets(process)) {
+            return process;
+        }
+        winner -= lotteryTickets(process);
+    }
+    return NULL;
+}
+
+// Selectable policies (--policy=NAME)
+const SchedulingPolicy policies[] = {
+    {.name = "rr", .pick_next = pickFront, .time_slice = quantumSlice},
+    {.name = "mlfq", .preemptive = 1, .compare = compareLevel, .pick_next = pickMlfq, .time_slice = mlfqSlice,
+     .on_arrival = mlfqArrival, .on_block = mlfqCharge, .on_quantum_expire = mlfqCharge},
+    {.name = "sjf", .compare = compareRemaining, .pick_next = pickBest, .time_slice = unlimitedSlice},
+    {.name = "srtf", .preemptive = 1, .compare = compareRemaining, .pick_next = pickBest, .time_slice = unlimitedSlice},
+    {.name = "priority", .preemptive = 1, .compare = comparePriority, .pick_next = pickBest, .time_slice = quantumSlice},
+    {.name = "lottery", .pick_next = pickLottery, .time_slice = quantumSlice},
+};
+
+// Take a process from the back of the longest run queue of another core
+PCB *stealWork(Core *thief) {
+    Core *victim = NULL;
+    for (int i = 0; i < core_count; i++) {
+        if (&cores[i] != thief && cores[i].ready.size > 0 && (victim == NULL || cores[i].ready.size > victim->ready.size)) {
+            victim = &cores[i];
+        }
+    }
+    if (victim == NULL) {
+        return NULL;
+    }
+    PCB *process = victim->ready.rear;
+    removePCB(&victim->ready, process);
+    thief->steals++;
+    if (trace_level == TRACE_EVENT) {
+        printf("Core %d stole process %d from core %d\n", thief->id, process->process_id, victim->id);
+    }
+    return process;
+}
+
+// Give an idle core the next process from its own queue, or stolen from another core
+void dispatch(Core *core, int time) {
+    PCB *process = core->ready.size > 0 ? policy->pick_next(&core->ready) : NULL;
+    if (process != NULL) {
+        removePCB(&core->ready, process);
+    } else {
+        process = stealWork(core);
+    }
+    if (process == NULL) {
+        return;
+    }
+    if (process->swapped && swapIn(process) < 0) {
+        // No memory can be freed for it right now
+        enqueue(&core->ready, process);
+        return;
+    }
+
+    noteDecision(RECORD_DISPATCH, time, process, core->id);
+    if (trace_level == TRACE_EVENT) {
+        printf("Time %d: process %d dispatched", time, process->process_id);
+        printf(core_count > 1 ? " on core %d\n" : "\n", core->id);
+    }
+    enqueue(&running_queue, process);
+    traceState(time, process); // Trace after every scheduling event
+
+    process->state = RUNNING;
+    process->core = core->id;
+    if (process->start_time == NOT_STARTED) {
+        process->start_time = time;
+        metrics[process->process_id - 1].first_run = time;
+    }
+    core->current = process;
+    core->slice_left = policy->time_slice(process);
+    dispatches++;
+    metrics[process->process_id - 1].context_switches++;
+    metrics[process->process_id - 1].ready_wait += time - process->ready_since;
+}
+
+// Take the core back from its process if the policy ranks a ready process ahead of it
+void preemptIfBetter(Core *core, int time) {
+    PCB *process = core->current;
+    if (!policy->preemptive || process == NULL || core->ready.size == 0) {
+        return;
+    }
+    PCB *candidate = policy->pick_next(&core->ready);
+    if (candidate == NULL || policy->compare(candidate, process) >= 0) {
+        return;
+    }
+    if (trace_level == TRACE_EVENT) {
+        printf("Time %d: process %d preempted by process %d\n", time, process->process_id, candidate->process_id);
+    }
+    noteDecision(RECORD_PREEMPT, time, process, candidate->process_id);
+    metrics[process->process_id - 1].preemptions++;
+    makeReady(process);
+    core->current = NULL;
+    dispatch(core, time);
+}
+
+// Execute one instruction of the process running on a core during tick `time`, then up to `chain`
+// more chainable ones as the following ticks; the clock is moved past those
+void runCoreTick(Core *core, int time, int chain) {
+    PCB *process = core->current;
+    if (programEnded(process)) {
+        // It blocked on its last instruction, so nothing is left to run
+        terminateProcess(process, time);
+        core->current = NULL;
+        return;
+    }
+
+    if (trace_level == TRACE_FULL) {
+        printf("Current Time: %d\n", time);
+        printf("Currently Executing Process ID: %d\n", process->process_id);
+        printf("Instruction: %s\n", wordValue(process->program_counter));
+    } else if (trace_level == TRACE_EVENT) {
+        printf("Time %d: process %d executes '%s'\n", time, process->process_id, wordValue(process->program_counter));
+    }
+
+    Instruction *ins = &decoded[process->program_counter];
+    int malformed = ins->opcode == OP_MALFORMED;
+    if (malformed) {
+        TRACE(TRACE_SUMMARY, "Malformed instruction encountered. Skipping...\n");
+    } else {
+        int chained = executeInstruction(core, process, ins, chain);
+        instructions_executed++;
+        time += chained;
+        current_time += chained;
+    }
+    chargeTick(core, process);
+
+    if (process->state == BLOCKED || process->state == WAITING) {
+        if (policy->on_block != NULL) {
+            policy->on_block(process);
+        }
+        if (process->state == BLOCKED) {
+            noteDecision(RECORD_BLOCK, time, process, process->waiting_on);
+        } else {
+            noteDecision(RECORD_WAIT_IO, time, process, -1);
+        }
+        if (trace_level == TRACE_EVENT && process->state == BLOCKED) {
+            printf("Time %d: process %d blocked on %s\n", time, process->process_id, process->blocked_resource);
+        } else if (trace_level == TRACE_EVENT) {
+            printf("Time %d: process %d waits for I/O\n", time, process->process_id);
+        }
+        core->current = NULL;
+        return;
+    }
+    if (!malformed) {
+        traceState(time + 1, process);
+    }
+
+    if (programEnded(process)) {
+        terminateProcess(process, time + 1);
+        core->current = NULL;
+    } else if (core->slice_left == 0) {
+        noteDecision(RECORD_EXPIRE, time, process, 0);
+        if (policy->on_quantum_expire != NULL) {
+            policy->on_quantum_expire(process);
+        }
+        metrics[process->process_id - 1].preemptions++;
+        makeReady(process);
+        core->current = NULL;
+    }
+}
+
+// Wait, holding kernel_lock, until a turn of the current tick comes to a thread's slot
+void waitForTurn(int *turn, int slot) {
+    while (*turn != slot) {
+        pthread_cond_wait(&turn_changed, &kernel_lock);
+    }
+}
+
+// Give a turn of the current tick to the next slot in core order
+void passTurn(int *turn) {
+    (*turn)++;
+    pthread_cond_broadcast(&turn_changed);
+}
+
+// Copy the text of an operand into `out` as operandValue would return it, without rendering,
+// binding or caching anything
+void peekOperand(PCB *pcb, int name, char *out) {
+    int slot = lookupVariable(pcb, name);
+    if (slot < 0) {
+        strcpy(out, internName(name));
+        return;
+    }
+    int index = varAddress(pcb, slot);
+    if (word_state[index] == WORD_INTEGER) {
+        snprintf(out, MAX_VALUE_LENGTH + 1, "%lld", word_int[index]);
+    } else {
+        strcpy(out, word_capacity[index] > 0 ? value_arena + word_offset[index] : "");
+    }
+}
+
+// Copy out the operands of the host I/O the process's next instruction does, so its thread can do
+// that I/O before its turn to run the tick. Returns the resource guarding it, or RESOURCE_NONE when
+// the instruction does none or has to do it in its turn: console input, and program output that
+// shares stdout with the trace.
+enum Resource prepareHostIO(PCB *process) {
+    ProcessThread *thread = process->thread;
+    if (programEnded(process)) {
+        return RESOURCE_NONE;
+    }
+    Instruction *ins = &decoded[process->program_counter];
+    thread->io_opcode = ins->opcode;
+    switch (ins->opcode) {
+        case OP_PRINT:
+            if (program_output == stdout || lookupVariable(process, ins->arg1) < 0) {
+                return RESOURCE_NONE;
+            }
+            peekOperand(process, ins->arg1, thread->io_value);
+            return RESOURCE_USER_OUTPUT;
+        case OP_PRINT_FROM_TO:
+            if (program_output == stdout) {
+                return RESOURCE_NONE;
+            }
+            peekOperand(process, ins->arg1, thread->io_name);
+            peekOperand(process, ins->arg2, thread->io_value);
+            return RESOURCE_USER_OUTPUT;
+        case OP_WRITE_FILE:
+            if (io_mode == IO_ASYNC) {
+                return RESOURCE_NONE;
+            }
+            peekOperand(process, ins->arg1, thread->io_name);
+            peekOperand(process, ins->arg2, thread->io_value);
+            return RESOURCE_FILE;
+        case OP_READ_FILE:
+        case OP_ASSIGN_READFILE:
+            if (io_mode == IO_ASYNC) {
+                return RESOURCE_NONE;
+            }
+            peekOperand(process, ins->opcode == OP_READ_FILE ? ins->arg1 : ins->arg2, thread->io_name);
+            return RESOURCE_FILE;
+        default:
+            return RESOURCE_NONE;
+    }
+}
+
+// Body of a process's host thread. A tick handed to it runs in three steps: in core order, claim the
+// semaphore of the instruction's host I/O; do that I/O outside the simulation lock, overlapping the
+// other cores; then, in core order again, run the tick. I/O on each resource and every change to the
+// simulated state so happen in the order of the lock-step loop.
+void *processThread(void *arg) {
+    PCB *process = arg;
+    ProcessThread *thread = process->thread;
+    pthread_mutex_lock(&kernel_lock);
+    for (;;) {
+        while (thread->core == NULL && process->state != TERMINATED) {
+            pthread_cond_wait(&thread->turn, &kernel_lock);
+        }
+        if (thread->core == NULL) {
+            break; // killed while parked
+        }
+        handoffs++;
+        handoff_ns += elapsedNs(&thread->handed_at);
+        Core *core = thread->core;
+        thread->core = NULL;
+
+        waitForTurn(&prepare_turn, thread->slot);
+        enum Resource resource = prepareHostIO(process);
+        if (resource == RESOURCE_NONE) {
+            passTurn(&prepare_turn);
+        } else {
+            // The semaphore is taken before the next core's turn, so I/O on it keeps the core order
+            long long waited = beginIO(resource);
+            pthread_mutex_lock(&kernel_lock);
+            passTurn(&prepare_turn);
+            pthread_mutex_unlock(&kernel_lock);
+            thread->io_status = performHostIO(thread->io_opcode, thread->io_name, thread->io_value);
+            endIO(resource, waited);
+            thread->prefetched = 1;
+        }
+
+        waitForTurn(&commit_turn, thread->slot);
+        runCoreTick(core, current_time, 0);
+        thread->prefetched = 0;
+        passTurn(&commit_turn);
+
+        int finished = process->state == TERMINATED;
+        if (--ticks_outstanding == 0) {
+            pthread_cond_signal(&ticks_done);
+        }
+        if (finished) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&kernel_lock);
+    return NULL;
+}
+
+// Let the thread of a terminated process exit, then join it and free the process
+void reapProcess(PCB *process) {
+    pthread_mutex_lock(&kernel_lock);
+    pthread_cond_signal(&process->thread->turn);
+    pthread_mutex_unlock(&kernel_lock);
+    pthread_join(process->thread->id, NULL);
+    pthread_cond_destroy(&process->thread->turn);
+    free(process->thread);
+    free(process);
+}
+
+// Return processes whose file instruction has completed by `time` to the ready queues, in issue order.
+// With a simulated latency a request completes exactly `io_latency` ticks after it was issued,
+// so the scheduler waits for a worker that is slower than that; with real latency it completes
+// at the first tick after the worker finishes.
+void completeIO(int time) {
+    PCB *process = io_wait_queue.front;
+    while (process != NULL) {
+        PCB *next = process->next;
+        IORequest *request = process->io;
+        if (io_latency >= 0 && (int)request->complete_at > time) {
+            process = next;
+            continue;
+        }
+
+        pthread_mutex_lock(&io_lock);
+        if (io_latency >= 0 && !request->done) {
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            while (!request->done) {
+                pthread_cond_wait(&io_finished, &io_lock);
+            }
+            io_stall_ns += elapsedNs(&start);
+        }
+        int done = request->done;
+        pthread_mutex_unlock(&io_lock);
+        if (!done) {
+            process = next;
+            continue;
+        }
+
+        finishFileRead(process, request->ins, request->name, request->value, request->status);
+        noteDecision(RECORD_UNBLOCK, time, process, -1);
+        metrics[process->process_id - 1].io_wait += time - request->issued_at;
+        io_wait_ticks += time - request->issued_at;
+        process->io = NULL;
+        free(request);
+        if (trace_level == TRACE_EVENT) {
+            printf("Time %d: process %d finished its I/O\n", time, process->process_id);
+        }
+        if (programEnded(process)) {
+            removePCB(&io_wait_queue, process);
+            int threaded_victim = process->thread != NULL;
+            terminateProcess(process, time); // frees the process unless a thread still runs it
+            if (threaded_victim) {
+                reapProcess(process);
+            }
+        } else {
+            makeReady(process);
+        }
+        process = next;
+    }
+}
+
+// Block until some outstanding I/O request is done; used when only real-latency I/O is pending
+void waitForIO() {
+    pthread_mutex_lock(&io_lock);
+    for (;;) {
+        for (PCB *process = io_wait_queue.front; process != NULL; process = process->next) {
+            if (process->io->done) {
+                pthread_mutex_unlock(&io_lock);
+                return;
+            }
+        }
+        pthread_cond_wait(&io_finished, &io_lock);
+    }
+}
+
+// Hand this tick to the thread of every core's running process at once and wait until all have run it.
+// The threads take their turns in core order, so the result does not depend on which runs first.
+void runThreadedTicks() {
+    PCB *ran[core_count];
+    pthread_mutex_lock(&kernel_lock);
+    prepare_turn = commit_turn = 0;
+    for (int i = 0; i < core_count; i++) {
+        PCB *process = ran[i] = cores[i].current;
+        if (process == NULL) {
+            continue;
+        }
+        if (process->thread == NULL) {
+            process->thread = calloc(1, sizeof(ProcessThread));
+            pthread_cond_init(&process->thread->turn, NULL);
+            if (pthread_create(&process->thread->id, NULL, processThread, process) != 0) {
+                perror("Failed to create process thread");
+                exit(EXIT_FAILURE);
+            }
+        }
+        process->thread->core = &cores[i];
+        process->thread->slot = ticks_outstanding++;
+        clock_gettime(CLOCK_MONOTONIC, &process->thread->handed_at);
+        pthread_cond_signal(&process->thread->turn);
+    }
+    while (ticks_outstanding > 0) {
+        pthread_cond_wait(&ticks_done, &kernel_lock);
+    }
+    pthread_mutex_unlock(&kernel_lock);
+
+    // Reap the threads of processes that terminated this tick
+    for (int i = 0; i < core_count; i++) {
+        if (ran[i] != NULL && ran[i]->state == TERMINATED) {
+            reapProcess(ran[i]);
+        }
+    }
+}
+
+// Print the processes of the last deadlock search and what each waits for
+void reportDeadlock(FILE *out, int time) {
+    fprintf(out, "Deadlock detected at time %d:\n", time);
+    for (int i = 0; i < program_count; i++) {
+        PCB *process = processes[i];
+        if (process == NULL || process->deadlock_mark != deadlock_generation || !process->deadlock_stuck) {
+            continue;
+        }
+        ResourceEntry *resource = &resources[process->waiting_on];
+        fprintf(out, "  process %d waits for %s held by process", process->process_id, internName(resource->name));
+        for (int j = 0; j < resource->holder_count; j++) {
+            fprintf(out, "%s %d", j > 0 ? "," : "", resource->holders[j]->process_id);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// Units of all resources a process holds
+int unitsHeldTotal(PCB *process) {
+    int units = 0;
+    for (int i = 0; i < resource_count; i++) {
+        units += unitsHeld(&resources[i], process);
+    }
+    return units;
+}
+
+// Whether `a` is a better deadlock victim than `b` under the victim policy
+int betterVictim(PCB *a, PCB *b) {
+    if (victim_policy == VICTIM_LOWEST_PRIORITY && a->base_priority != b->base_priority) {
+        return a->base_priority > b->base_priority;
+    }
+    if (victim_policy == VICTIM_FEWEST_UNITS && unitsHeldTotal(a) != unitsHeldTotal(b)) {
+        return unitsHeldTotal(a) < unitsHeldTotal(b);
+    }
+    if (a->release_time != b->release_time) {
+        return a->release_time > b->release_time;
+    }
+    return a->process_id > b->process_id;
+}
+
+// Take a victim out of its wait queue and give back every unit it holds
+void releaseVictim(PCB *victim) {
+    removeFromHeap(&resources[victim->waiting_on].waiters, victim);
+    recordUnblocked(victim);
+    victim->waiting_on = -1;
+    for (int i = 0; i < resource_count; i++) {
+        while (removeHolder(&resources[i], victim)) {
+            releaseUnit(&resources[i]);
+        }
+    }
+}
+
+// Resolve the deadlocks found during the last tick under the recovery policy
+void resolveDeadlocks(int time) {
+    for (int i = 0; i < deadlock_pending_count; i++) {
+        PCB *blocked = processes[deadlock_pending[i] - 1];
+        deadlock_generation++;
+        if (blocked == NULL || !isStuck(blocked)) {
+            continue; // already broken by an earlier victim
+        }
+        deadlocks_detected++;
+        if (deadlock_recovery == RECOVER_ABORT) {
+            fflush(stdout);
+            reportDeadlock(stderr, time);
+            exit(EXIT_FAILURE);
+        }
+        if (trace_level >= TRACE_SUMMARY) {
+            reportDeadlock(stdout, time);
+        }
+
+        PCB *victim = NULL;
+        for (int j = 0; j < program_count; j++) {
+            PCB *process = processes[j];
+            if (process != NULL && process->deadlock_mark == deadlock_generation && process->deadlock_stuck &&
+                (victim == NULL || betterVictim(process, victim))) {
+                victim = process;
+            }
+        }
+        releaseVictim(victim);
+        if (deadlock_recovery == RECOVER_KILL) {
+            TRACE(TRACE_SUMMARY, "Killing process %d to break the deadlock.\n", victim->process_id);
+            int threaded_victim = victim->thread != NULL;
+            metrics[victim->process_id - 1].killed = 1;
+            terminateProcess(victim, time); // frees the victim unless a thread still runs it
+            if (threaded_victim) {
+                reapProcess(victim);
+            }
+        } else {
+            TRACE(TRACE_SUMMARY, "Rolling back process %d to break the deadlock.\n", victim->process_id);
+            if (victim->swapped) {
+                ((SwapHeader *)(swap_map + swap_offsets[victim->process_id - 1]))->pc_offset = 0;
+            } else {
+                victim->program_counter = images[victim->image].text_base;
+            }
+            victim->ticks_run = 0;
+            victim->priority = victim->base_priority;
+            makeReady(victim);
+        }
+    }
+    deadlock_pending_count = 0;
+}
+
+// Report processes that can never run again, e.g. waiting for units whose holders exited
+void reportStall(int time) {
+    fflush(stdout);
+    fprintf(stderr, "Error: no process can run at time %d:\n", time);
+    for (int i = 0; i < program_count; i++) {
+        PCB *process = processes[i];
+        if (process != NULL && process->state == BLOCKED) {
+            fprintf(stderr, "  process %d waits for %s\n", process->process_id, process->blocked_resource);
+        } else if (process != NULL && process->queue == &memory_wait_queue) {
+            fprintf(stderr, "  process %d waits for memory\n", process->process_id);
+        } else if (process != NULL && process->swapped && process->state == READY) {
+            fprintf(stderr, "  process %d cannot be swapped back in\n", process->process_id);
+        }
+    }
+}
+
+#define CHECKPOINT_MAGIC "OSMSCKPT"
+#define CHECKPOINT_VERSION 3
+
+// Fixed part at the start of a checkpoint file. The sections after it, in order: interned strings,
+// memory words, free regions, program images, processes, queues and heaps, cores, resources, metrics,
+// in-flight I/O, cached files, the input stream and swapped images.
+// Processes are always stored by id, never by address.
+typedef struct CheckpointHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int pcb_size;         // record layouts the file was written with
+    unsigned int instruction_size;
+    unsigned int metrics_size;
+    unsigned int io_request_size;
+    int core_count;
+    int memory_size;
+    int program_count;
+    int terminated_count;
+    int current_time;
+    int batch_mode;
+    int policy;                    // index into policies[]
+    int aging_interval;            // settings that shape the schedule, as in ReplayHeader
+    int priority_inheritance;
+    int deadlock_recovery;
+    int victim_policy;
+    int fit_policy;
+    int swap_enabled;
+    int event_driven;
+    int io_mode;
+    int io_latency;
+    int mlfq_last_boost;
+    unsigned int lottery_state;
+    unsigned long wait_sequence;
+    unsigned long deadlock_generation;
+    unsigned long deadlocks_detected;
+    unsigned long instructions_executed;
+    unsigned long dispatches;
+    unsigned long swap_outs, swap_ins;
+    unsigned long long swap_bytes_out, swap_bytes_in;
+    unsigned long io_requests;
+    unsigned long long io_wait_ticks;
+    int interned_count;
+    int resource_count;
+} CheckpointHeader;
+
+const char *checkpoint_path = "OSms2.ckpt";
+int checkpoint_interval = 0;                    // ticks between checkpoints, 0 = only on SIGUSR1
+int last_checkpoint = 0;
+unsigned long checkpoints_written = 0;
+const char *restore_path = NULL;
+
+// Options that shape the schedule. A restored run takes them from the checkpoint,
+// so one given on the command line must agree with it.
+enum ScheduleSetting {
+    SET_CORES, SET_MEMORY, SET_AGING, SET_INHERIT, SET_DEADLOCK, SET_VICTIM, SET_FIT, SET_SWAP, SET_TICK, SET_IO,
+    SET_IO_LATENCY
+};
+
+const char *setting_options[] = {"--cores", "--memory", "--aging", "--inherit", "--deadlock", "--victim", "--fit",
+                                 "--no-swap", "--tick", "--io", "--io-latency"};
+unsigned int settings_given = 0; // one bit per ScheduleSetting given on the command line
+
+void requestCheckpoint(int signal_number) {
+    (void)signal_number;
+    checkpoint_requested = 1;
+}
+
+void putQueue(FILE *out, Queue *queue) {
+    putInt(out, queue->size);
+    for (PCB *process = queue->front; process != NULL; process = process->next) {
+        putInt(out, process->process_id);
+    }
+}
+
+// A heap is stored in array order, which pushing back in the same order reproduces exactly
+void putHeap(FILE *out, ProcessHeap *heap) {
+    putInt(out, heap->size);
+    for (int i = 0; i < heap->size; i++) {
+        putInt(out, heap->items[i]->process_id);
+    }
+}
+
+// Bytes a swapped image occupies in its slot
+size_t swapImageLength(const char *slot) {
+    const SwapHeader *header = (const SwapHeader *)slot;
+    size_t length = sizeof(SwapHeader);
+    for (int i = 0; i < header->words; i++) {
+        SwapWord word;
+        memcpy(&word, slot + length, sizeof(SwapWord));
+        length += sizeof(SwapWord) + word.length;
+    }
+    return length;
+}
+
+// Save the whole simulator state between two ticks. The file is written next to `path` and renamed
+// over it once complete, so a crash mid-write leaves the previous checkpoint intact.
+void writeCheckpoint(const char *path) {
+    // Only finished I/O requests are saved
+    pthread_mutex_lock(&io_lock);
+    for (PCB *process = io_wait_queue.front; process != NULL; process = process->next) {
+        while (!process->io->done) {
+            pthread_cond_wait(&io_finished, &io_lock);
+        }
+    }
+    pthread_mutex_unlock(&io_lock);
+
+    char temp[512];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE *out = fopen(temp, "wb");
+    if (out == NULL) {
+        TRACE(TRACE_SUMMARY, "Warning: could not create checkpoint '%s'.\n", temp);
+        return;
+    }
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.pcb_size = sizeof(PCB);
+    header.instruction_size = sizeof(Instruction);
+    header.metrics_size = sizeof(ProcessMetrics);
+    header.io_request_size = sizeof(IORequest);
+    header.core_count = core_count;
+    header.memory_size = memory_size;
+    header.program_count = program_count;
+    header.terminated_count = terminated_count;
+    header.current_time = current_time;
+    header.batch_mode = batch_mode;
+    header.policy = policy - policies;
+    header.aging_interval = aging_interval;
+    header.priority_inheritance = priority_inheritance;
+    header.deadlock_recovery = deadlock_recovery;
+    header.victim_policy = victim_policy;
+    header.fit_policy = fit_policy;
+    header.swap_enabled = swap_enabled;
+    header.event_driven = event_driven;
+    header.io_mode = io_mode;
+    header.io_latency = io_latency;
+    header.mlfq_last_boost = mlfq_last_boost;
+    header.lottery_state = lottery_state;
+    header.wait_sequence = wait_sequence;
+    header.deadlock_generation = deadlock_generation;
+    header.deadlocks_detected = deadlocks_detected;
+    header.instructions_executed = instructions_executed;
+    header.dispatches = dispatches;
+    header.swap_outs = swap_outs;
+    header.swap_ins = swap_ins;
+    header.swap_bytes_out = swap_bytes_out;
+    header.swap_bytes_in = swap_bytes_in;
+    header.io_requests = io_requests;
+    header.io_wait_ticks = io_wait_ticks;
+    header.interned_count = interned_count;
+    header.resource_count = resource_count;
+    putBytes(out, &header, sizeof(header));
+
+    for (int i = 0; i < interned_count; i++) {
+        putString(out, interned[i]);
+    }
+
+    // Every memory word: tag, name, value (length -1 if it has none) and decoded instruction
+    for (int i = 0; i < memory_size; i++) {
+        putInt(out, word_tag[i]);
+        putInt(out, word_name[i]);
+        const char *value = wordValue(i); // renders a pending integer, which may give the word a value
+        if (word_capacity[i] > 0) {
+            putString(out, value);
+        } else {
+            putInt(out, -1);
+        }
+        putBytes(out, &decoded[i], sizeof(Instruction));
+    }
+    putInt(out, free_region_count);
+    putBytes(out, free_regions, free_region_count * sizeof(FreeRegion));
+
+    // Program images in index order, so the image index in each PCB stays valid
+    putInt(out, image_count);
+    for (int i = 0; i < image_count; i++) {
+        ProgramImage *image = &images[i];
+        putString(out, image->path);
+        putInt(out, image->size);
+        for (int j = 0; j < image->size; j++) {
+            putString(out, image->lines[j]);
+        }
+        putInt(out, image->text_base);
+        putInt(out, image->residents);
+        putInt(out, image->decoded != NULL);
+        if (image->decoded != NULL) {
+            putBytes(out, image->decoded, image->size * sizeof(Instruction));
+        }
+    }
+
+    for (int i = 0; i < program_count; i++) {
+        PCB *process = processes[i];
+        putInt(out, process != NULL);
+        if (process != NULL) {
+            putBytes(out, process, sizeof(PCB));
+        }
+    }
+
+    putQueue(out, &running_queue);
+    putQueue(out, &memory_wait_queue);
+    putQueue(out, &io_wait_queue);
+    putHeap(out, &started_queue);
+    for (int i = 0; i < core_count; i++) {
+        putInt(out, cores[i].current != NULL ? cores[i].current->process_id : 0);
+        putInt(out, cores[i].slice_left);
+        putBytes(out, &cores[i].busy_ticks, sizeof(cores[i].busy_ticks));
+        putBytes(out, &cores[i].steals, sizeof(cores[i].steals));
+        putQueue(out, &cores[i].ready);
+    }
+
+    for (int i = 0; i < resource_count; i++) {
+        ResourceEntry *resource = &resources[i];
+        int free_units;
+        sem_getvalue(&resource->lock, &free_units);
+        putInt(out, resource->name);
+        putInt(out, resource->count);
+        putInt(out, resource->declared);
+        putInt(out, free_units);
+        putInt(out, resource->holder_count);
+        for (int j = 0; j < resource->holder_count; j++) {
+            putInt(out, resource->holders[j]->process_id);
+        }
+        putHeap(out, &resource->waiters);
+    }
+
+    for (int i = 0; i < program_count; i++) {
+        putBytes(out, &metrics[i], sizeof(ProcessMetrics));
+        if (metrics[i].blocked_resources > 0) {
+            putBytes(out, metrics[i].blocked_by_resource, metrics[i].blocked_resources * sizeof(unsigned int));
+        }
+    }
+
+    // The request of each waiting process, in I/O wait queue order
+    for (PCB *process = io_wait_queue.front; process != NULL; process = process->next) {
+        putInt(out, process->io->ins - decoded);
+        putBytes(out, process->io, sizeof(IORequest));
+    }
+
+    putInt(out, vfs_count);
+    for (int i = 0; i < vfs_count; i++) {
+        VfsFile *file = &vfs_files[i];
+        putString(out, file->path);
+        putInt(out, file->data != NULL ? (int)file->length : -1);
+        if (file->data != NULL) {
+            putBytes(out, file->data, file->length);
+        }
+        putInt(out, file->dirty);
+    }
+
+    putInt(out, input_count);
+    putInt(out, input_next);
+    for (int i = 0; i < input_count; i++) {
+        putString(out, input_stream[i]);
+    }
+
+    // Swapped images, ended by process id 0
+    for (int i = 0; i < program_count; i++) {
+        if (processes[i] != NULL && processes[i]->swapped) {
+            const char *slot = swap_map + swap_offsets[i];
+            int length = swapImageLength(slot);
+            putInt(out, i + 1);
+            putInt(out, length);
+            putBytes(out, slot, length);
+        }
+    }
+    putInt(out, 0);
+
+    int failed = ferror(out);
+    if (fclose(out) != 0 || failed || rename(temp, path) != 0) {
+        TRACE(TRACE_SUMMARY, "Warning: could not write checkpoint '%s'.\n", path);
+        remove(temp);
+        return;
+    }
+    checkpoints_written++;
+    TRACE(TRACE_EVENT, "Time %d: checkpoint written to %s\n", current_time, path);
+}
+
+// Instructions the process on a core may run straight after this tick's, as the ticks that follow.
+// Running ahead is only invisible with a single core, no per-instruction trace and no pacing, and
+// when no decision is due: the chain stops before the next I/O completion and checkpoint, and
+// under a preemptive policy before the next release and whenever a ready process could preempt.
+int chainLimit(Core *core) {
+    if (core_count > 1 || trace_level >= TRACE_EVENT || pacing_mode != PACE_MAX ||
+        (policy->preemptive && core->ready.size > 0) || (io_latency < 0 && io_wait_queue.size > 0)) {
+        return 0;
+    }
+    int until = INT_MAX;
+    PCB *next_release = peekHeap(&started_queue);
+    if (policy->preemptive && next_release != NULL) {
+        until = next_release->release_time;
+    }
+    for (PCB *process = io_wait_queue.front; process != NULL; process = process->next) {
+        if ((int)process->io->complete_at < until) {
+            until = process->io->complete_at;
+        }
+    }
+    if (checkpoint_interval > 0 && last_checkpoint + checkpoint_interval < until) {
+        until = last_checkpoint + checkpoint_interval;
+    }
+    return until - current_time > 1 ? until - current_time - 1 : 0;
+}
+
+// Run the scheduling policy one tick at a time on every core until all processes terminate
+int schedule() {
+    while (terminated_count < program_count) {
+        struct timespec decision_start;
+        if (bench_report) {
+            clock_gettime(CLOCK_MONOTONIC, &decision_start);
+        }
+
+        if (checkpoint_requested || (checkpoint_interval > 0 && current_time - last_checkpoint >= checkpoint_interval)) {
+            checkpoint_requested = 0;
+            last_checkpoint = current_time;
+            writeCheckpoint(checkpoint_path);
+        }
+
+        if (io_wait_queue.size > 0) {
+            completeIO(current_time);
+            if (terminated_count == program_count) {
+                break;
+            }
+        }
+
+        // Released processes join the run queues whenever a core is about to pick its next process,
+        // or at once when the policy may preempt for them
+        int idle = policy->preemptive;
+        for (int i = 0; i < core_count; i++) {
+            idle |= cores[i].current == NULL;
+        }
+        while (idle && started_queue.size > 0 && peekHeap(&started_queue)->release_time <= current_time) {
+            admitProcess(popHeap(&started_queue));
+        }
+
+        for (int i = 0; i < core_count; i++) {
+            if (cores[i].current == NULL) {
+                dispatch(&cores[i], current_time);
+            } else {
+                preemptIfBetter(&cores[i], current_time);
+            }
+        }
+
+        if (bench_report) {
+            scheduling_ns += elapsedNs(&decision_start);
+        }
+
+        int executed = 0;
+        for (int i = 0; i < core_count; i++) {
+            executed |= cores[i].current != NULL;
+        }
+        int previous_time = current_time;
+        tick_in_progress = 1;
+        if (threaded) {
+            runThreadedTicks();
+        } else {
+            for (int i = 0; i < core_count; i++) {
+                if (cores[i].current != NULL) {
+                    runCoreTick(&cores[i], current_time, chainLimit(&cores[i]));
+                }
+            }
+        }
+
+        if (deadlock_pending_count > 0) {
+            resolveDeadlocks(current_time + executed);
+        }
+        tick_in_progress = 0;
+
+        if (executed) {
+            current_time++;
+            paceTick();
+        } else {
+            // Every core was idle, so a process still ready is one that could not be swapped in;
+            // it counts as runnable no more than an empty ready queue does
+            int ready = 0;
+            for (int i = 0; i < core_count; i++) {
+                for (PCB *process = cores[i].ready.front; process != NULL; process = process->next) {
+                    ready += !process->swapped;
+                }
+            }
+            if (ready == 0 && started_queue.size == 0 && io_wait_queue.size == 0) {
+                reportStall(current_time);
+                exit(EXIT_FAILURE);
+            }
+            if (io_latency < 0 && io_wait_queue.size > 0 && ready == 0) {
+                waitForIO();
+            }
+            // Nothing is runnable, so nothing can happen before the next event
+            current_time = event_driven ? nextEventTime(current_time) : current_time + 1;
+        }
+
+        // Write back whenever time reaches or jumps past a multiple of the interval
+        if (fs_mode == FS_CACHED && fs_writeback_interval > 0 &&
+            current_time / fs_writeback_interval != previous_time / fs_writeback_interval) {
+            // I/O workers may be using the cache
+            while (sem_wait(&file_mutex) != 0 && errno == EINTR) {
+            }
+            vfsWriteBack();
+            sem_post(&file_mutex);
+        }
+    }
+    return current_time;
+}
+
+// Print how busy each core was over a run of `total_time` ticks
+void printCoreUtilization(int total_time) {
+    for (int i = 0; i < core_count; i++) {
+        TRACE(TRACE_SUMMARY, "Core %d: busy %lu of %d ticks (%.1f%%), %lu steals\n", i, cores[i].busy_ticks, total_time,
+              total_time > 0 ? 100.0 * cores[i].busy_ticks / total_time : 0.0, cores[i].steals);
+    }
+}
+
+// Latency figures computed for every process
+enum Latency {
+    LATENCY_TURNAROUND, // completion - arrival
+    LATENCY_RESPONSE,   // first run - arrival
+    LATENCY_WAITING,    // ticks spent in ready queues
+    LATENCY_COUNT
+};
+
+const char *latency_names[LATENCY_COUNT] = {"turnaround", "response", "waiting"};
+
+unsigned int latencyOf(ProcessMetrics *m, enum Latency kind) {
+    switch (kind) {
+        case LATENCY_TURNAROUND:
+            return m->completion - m->arrival;
+        case LATENCY_RESPONSE:
+            return m->first_run - m->arrival;
+        default:
+            return m->ready_wait;
+    }
+}
+
+int compareUnsigned(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+    return x < y ? -1 : x > y;
+}
+
+// One latency of every process, sorted ascending; the caller frees it
+unsigned int *sortedLatencies(enum Latency kind) {
+    unsigned int *values = malloc((program_count + 1) * sizeof(unsigned int));
+    for (int i = 0; i < program_count; i++) {
+        values[i] = latencyOf(&metrics[i], kind);
+    }
+    qsort(values, program_count, sizeof(unsigned int), compareUnsigned);
+    return values;
+}
+
+// Nearest-rank percentile of sorted values
+unsigned int percentile(unsigned int *sorted, int count, int p) {
+    int rank = (p * count + 99) / 100;
+    return count == 0 ? 0 : sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// Busy ticks of all cores as a share of the ticks they were available
+double utilization(int end_time) {
+    unsigned long busy = 0;
+    for (int i = 0; i < core_count; i++) {
+        busy += cores[i].busy_ticks;
+    }
+    return end_time > 0 ? (double)busy / ((double)end_time * core_count) : 0.0;
+}
+
+// Print the system-wide figures at summary level
+void printMetricsSummary(int end_time) {
+    if (program_count == 0) {
+        return;
+    }
+    double totals[LATENCY_COUNT] = {0};
+    for (int i = 0; i < program_count; i++) {
+        for (int kind = 0; kind < LATENCY_COUNT; kind++) {
+            totals[kind] += latencyOf(&metrics[i], kind);
+        }
+    }
+    TRACE(TRACE_SUMMARY, "Policy %s: average turnaround %.2f ticks, average response %.2f ticks\n", policy->name,
+          totals[LATENCY_TURNAROUND] / program_count, totals[LATENCY_RESPONSE] / program_count);
+    TRACE(TRACE_SUMMARY, "Utilization %.1f%%, throughput %.3f processes per tick\n", 100.0 * utilization(end_time),
+          end_time > 0 ? (double)program_count / end_time : 0.0);
+    for (int kind = 0; kind < LATENCY_COUNT; kind++) {
+        unsigned int *sorted = sortedLatencies(kind);
+        TRACE(TRACE_SUMMARY, "%s: p50 %u, p90 %u, p99 %u, max %u ticks\n", latency_names[kind], percentile(sorted, program_count, 50),
+              percentile(sorted, program_count, 90), percentile(sorted, program_count, 99), sorted[program_count - 1]);
+        free(sorted);
+    }
+}
+
+// Write one CSV row per process
+void writeMetricsCsv(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Could not create '%s'.\n", path);
+        return;
+    }
+    fprintf(out, "process,arrival,first_run,completion,turnaround,response,cpu_ticks,ready_wait,blocked_wait,io_wait,preemptions,context_switches,killed");
+    for (int r = 0; r < resource_count; r++) {
+        fprintf(out, ",blocked_%s", internName(resources[r].name));
+    }
+    fprintf(out, "\n");
+    for (int i = 0; i < program_count; i++) {
+        ProcessMetrics *m = &metrics[i];
+        fprintf(out, "%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d", i + 1, m->arrival, m->first_run, m->completion,
+                latencyOf(m, LATENCY_TURNAROUND), latencyOf(m, LATENCY_RESPONSE), m->cpu_ticks, m->ready_wait,
+                m->blocked_wait, m->io_wait, m->preemptions, m->context_switches, m->killed);
+        for (int r = 0; r < resource_count; r++) {
+            fprintf(out, ",%u", r < m->blocked_resources ? m->blocked_by_resource[r] : 0);
+        }
+        fprintf(out, "\n");
+    }
+    fclose(out);
+}
+
+// Write the run, every process, and latency percentiles with power-of-two histograms as JSON
+void writeMetricsJson(const char *path, int end_time) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Could not create '%s'.\n", path);
+        return;
+    }
+    fprintf(out, "{\n  \"policy\": \"%s\",\n  \"cores\": %d,\n  \"end_time\": %d,\n", policy->name, core_count, end_time);
+    fprintf(out, "  \"instructions\": %lu,\n  \"context_switches\": %lu,\n", instructions_executed, dispatches);
+    fprintf(out, "  \"utilization\": %.4f,\n  \"throughput\": %.6f,\n", utilization(end_time),
+            end_time > 0 ? (double)program_count / end_time : 0.0);
+
+    fprintf(out, "  \"latency\": {");
+    for (int kind = 0; kind < LATENCY_COUNT; kind++) {
+        unsigned int *sorted = sortedLatencies(kind);
+        unsigned int max = program_count > 0 ? sorted[program_count - 1] : 0;
+        fprintf(out, "%s\n    \"%s\": {\"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u, \"histogram\": [", kind > 0 ? "," : "",
+                latency_names[kind], percentile(sorted, program_count, 50), percentile(sorted, program_count, 90),
+                percentile(sorted, program_count, 99), max);
+        // Bucket b counts values up to 2^b, above the previous bucket
+        int index = 0;
+        for (unsigned long bound = 1, previous = 0; ; previous = bound, bound *= 2) {
+            int count = 0;
+            while (index < program_count && sorted[index] <= bound) {
+                index++;
+                count++;
+            }
+            fprintf(out, "%s{\"le\": %lu, \"count\": %d}", previous > 0 ? ", " : "", bound, count);
+            if (bound >= max) {
+                break;
+            }
+        }
+        fprintf(out, "]}");
+        free(sorted);
+    }
+    fprintf(out, "\n  },\n");
+
+    fprintf(out, "  \"processes\": [");
+    for (int i = 0; i < program_count; i++) {
+        ProcessMetrics *m = &metrics[i];
+        fprintf(out, "%s\n    {\"process\": %d, \"arrival\": %u, \"first_run\": %u, \"completion\": %u, ", i > 0 ? "," : "",
+                i + 1, m->arrival, m->first_run, m->completion);
+        fprintf(out, "\"cpu_ticks\": %u, \"ready_wait\": %u, \"blocked_wait\": %u, \"io_wait\": %u, \"preemptions\": %u, ",
+                m->cpu_ticks, m->ready_wait, m->blocked_wait, m->io_wait, m->preemptions);
+        fprintf(out, "\"context_switches\": %u, \"killed\": %s, \"blocked\": {", m->context_switches, m->killed ? "true" : "false");
+        int first = 1;
+        for (int r = 0; r < m->blocked_resources; r++) {
+            if (m->blocked_by_resource[r] > 0) {
+                fprintf(out, "%s\"%s\": %u", first ? "" : ", ", internName(resources[r].name), m->blocked_by_resource[r]);
+                first = 0;
+            }
+        }
+        fprintf(out, "}}");
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+}
+
+void cleanup() {
+    // Free all remaining PCBs
+    for (int i = 0; i < program_count; i++) {
+        free(processes[i]);
+    }
+    free(processes);
+    for (int i = 0; i < program_count; i++) {
+        free(metrics[i].blocked_by_resource);
+    }
+    free(metrics);
+    free(cores);
+    free(started_queue.items);
+    free(word_tag);
+    free(word_name);
+    free(word_offset);
+    free(word_length);
+    free(word_capacity);
+    free(word_int);
+    free(word_state);
+    free(word_dirty);
+    free(dirty_words);
+    free(value_arena);
+    free(decoded);
+    for (int i = 0; i < interned_count; i++) {
+        free(interned[i]);
+    }
+    free(interned);
+    free(intern_table);
+    free(free_regions);
+    closeSwap();
+
+    // Destroy the semaphores
+    sem_destroy(&file_mutex);
+    sem_destroy(&input_mutex);
+    sem_destroy(&output_mutex);
+    for (int i = 0; i < resource_count; i++) {
+        sem_destroy(&resources[i].lock);
+        free(resources[i].holders);
+        free(resources[i].waiters.items);
+    }
+    free(resources);
+    free(resource_index);
+    free(deadlock_pending);
+    stopIOWorkers();
+    freeVfs();
+    freeImages();
+}
 
 
+// One process to run, from the manifest or the interactive prompts
+typedef struct WorkloadEntry {
+    int image;          // index into images[]
+    int release_time;
+    unsigned int quantum;
+    int priority;
+} WorkloadEntry;
 
+WorkloadEntry *workload = NULL;
+int workload_capacity = 0;
+unsigned int default_quantum = 2;
 
+// Add a program to the workload
+void addWorkload(const char *path, int release_time, unsigned int quantum, int priority) {
+    if (release_time < 0) {
+        fprintf(stderr, "Error: release time of '%s' must not be negative.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (program_count == workload_capacity) {
+        workload_capacity = workload_capacity == 0 ? 16 : workload_capacity * 2;
+        workload = realloc(workload, workload_capacity * sizeof(WorkloadEntry));
+        if (workload == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+    }
+    WorkloadEntry *entry = &workload[program_count++];
+    entry->image = loadImage(path);
+    entry->release_time = release_time;
+    entry->quantum = quantum;
+    entry->priority = priority;
+}
 
+// Read a workload manifest. Each line is one of
+//   program <path> <release time> [quantum] [priority]
+//   input <value>
+//   resource <name> <units>
+// and '#' starts a comment.
+void loadManifest(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Could not open manifest '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
 
-int main() {
-       
+    char line[MAX_LINE_LENGTH];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        line[strcspn(line, "#\r\n")] = '\0';
 
-    sem_init(&file_mutex, 0, 1);
-    sem_init(&input_mutex, 0, 1);
-    sem_init(&output_mutex, 0, 1);
+        char keyword[20], program[MAX_LINE_LENGTH], value[MAX_LINE_LENGTH];
+        int release_time;
+        unsigned int quantum = default_quantum;
+        int priority = 0, units;
+        if (sscanf(line, "%19s", keyword) != 1) {
+            continue;
+        }
+        if (strcmp(keyword, "program") == 0 && sscanf(line, "program %255s %d %u %d", program, &release_time, &quantum, &priority) >= 2) {
+            addWorkload(program, release_time, quantum, priority);
+        } else if (strcmp(keyword, "resource") == 0 && sscanf(line, "resource %19s %d", value, &units) == 2) {
+            declareResource(value, units);
+        } else if (strcmp(keyword, "input") == 0 && sscanf(line, "input %255s", value) == 1) {
+            addInput(value);
+        } else {
+            fprintf(stderr, "Error: %s:%d: malformed manifest line.\n", path, line_number);
+            exit(EXIT_FAILURE);
+        }
+    }
+    fclose(file);
+}
 
-    initQueue(&running_queue);
+// Read whitespace separated values into the input stream
+void loadInputs(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Could not open input file '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    char value[MAX_LINE_LENGTH];
+    while (fscanf(file, "%255s", value) == 1) {
+        addInput(value);
+    }
+    fclose(file);
+}
+
+// Cursor over a mapped checkpoint file
+typedef struct CheckpointReader {
+    char *data;
+    size_t size;
+    size_t offset;
+} CheckpointReader;
+
+CheckpointReader checkpoint_in;
+CheckpointHeader checkpoint_header;
+
+// Refuse a checkpoint from another version, or one that is truncated or inconsistent
+void rejectCheckpoint() {
+    fprintf(stderr, "Error: '%s' is not a valid checkpoint for this version of the simulator.\n", restore_path);
+    exit(EXIT_FAILURE);
+}
 
-    initQueue(&ready_queue);
-    initQueue(&started_queue);
-    initQueue(&blocked_queues[0]);
-    initQueue(&blocked_queues[1]);
-    initQueue(&blocked_queues[2]);
+void takeBytes(void *data, size_t size) {
+    if (size > checkpoint_in.size - checkpoint_in.offset) {
+        rejectCheckpoint();
+    }
+    memcpy(data, checkpoint_in.data + checkpoint_in.offset, size);
+    checkpoint_in.offset += size;
+}
 
+int takeInt() {
+    int value;
+    takeBytes(&value, sizeof(value));
+    return value;
+}
 
-    char* program1[MaxNumberOfStrings];
-    char* program2[MaxNumberOfStrings];
-    char* program3[MaxNumberOfStrings];
-    char*p1 = "program_1.txt";
-    char*p2 = "program_2.txt";
-    char*p3 = "program_3.txt";
-    int program1size = interpret( program1, 1);
-    int program2size = interpret( program2, 2);
-    int program3size = interpret( program3, 3);
+// A stored count, index or id, which must lie in [low, high]
+int takeIntIn(int low, int high) {
+    int value = takeInt();
+    if (value < low || value > high) {
+        rejectCheckpoint();
+    }
+    return value;
+}
 
+// A stored byte length, -1 for absent data; the data must fit in the rest of the file
+int takeLength() {
+    int length = takeIntIn(-1, INT_MAX - 1);
+    if (length > 0 && (size_t)length > checkpoint_in.size - checkpoint_in.offset) {
+        rejectCheckpoint();
+    }
+    return length;
+}
 
-   
+// A copy of a stored string, NULL if it was stored as absent
+char *takeString() {
+    int length = takeLength();
+    if (length < 0) {
+        return NULL;
+    }
+    char *text = malloc(length + 1);
+    if (text == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    takeBytes(text, length);
+    text[length] = '\0';
+    return text;
+}
 
+// A copy of a stored string that may not be absent
+char *takeRequiredString() {
+    char *text = takeString();
+    if (text == NULL) {
+        rejectCheckpoint();
+    }
+    return text;
+}
 
+PCB *takeProcess() {
+    int id = takeIntIn(1, program_count);
+    if (processes[id - 1] == NULL) {
+        rejectCheckpoint();
+    }
+    return processes[id - 1];
+}
 
-    // User inputs for release times and quantum times
-    int release_time1, release_time2, release_time3;
-    unsigned int quantum1, quantum2, quantum3;
-    printf("Enter release time for program 1: ");
-    scanf("%d", &release_time1);
-   
-    printf("Enter release time for program 2: ");
-    scanf("%d", &release_time2);
+// A queue is stored by process id; a process in more than one queue would corrupt the links
+void takeQueue(Queue *queue) {
+    int size = takeIntIn(0, program_count);
+    for (int i = 0; i < size; i++) {
+        PCB *process = takeProcess();
+        if (process->queue != NULL) {
+            rejectCheckpoint();
+        }
+        enqueue(queue, process);
+    }
+}
 
-    printf("Enter release time for program 3: ");
-    scanf("%d", &release_time3);
-    printf("Enter quantum time for The OS : ");
-    scanf("%u", &quantum3);
+void takeHeap(ProcessHeap *heap) {
+    int size = takeIntIn(0, program_count);
+    for (int i = 0; i < size; i++) {
+        pushHeap(heap, takeProcess());
+    }
+}
 
+// Whether a restored instruction only refers to names, resources, variable slots and lines that can exist
+int validInstruction(const Instruction *ins) {
+    int jump = ins->opcode >= OP_JUMP && ins->opcode <= OP_JUMP_GE;
+    return ins->opcode < OPCODE_COUNT && ins->arg1 >= 0 && ins->arg1 < interned_count && ins->arg2 >= 0 &&
+           ins->arg2 < interned_count && ins->resource >= RESOURCE_NONE && ins->resource < checkpoint_header.resource_count &&
+           ins->slot1 >= -1 && ins->slot1 < INPUT_SPACE_PER_PROCESS && ins->slot2 >= -1 &&
+           ins->slot2 < INPUT_SPACE_PER_PROCESS && ins->literal <= 1 && (!jump || (ins->imm >= 0 && ins->imm <= MAX_LINES));
+}
 
+// Whether a restored PCB agrees with the restored images and memory. Its links are reset by the caller.
+int validProcess(const PCB *process, int id) {
+    if (process->process_id != id || (unsigned int)process->state > TERMINATED || process->image < 0 ||
+        process->image >= image_count || process->program_size != images[process->image].size ||
+        process->core < -1 || process->core >= core_count || process->waiting_on < -1 ||
+        process->waiting_on >= checkpoint_header.resource_count || process->var < 0 ||
+        process->var > INPUT_SPACE_PER_PROCESS || (process->swapped != 0 && process->swapped != 1) ||
+        memchr(process->blocked_resource, '\0', sizeof(process->blocked_resource)) == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < INPUT_SPACE_PER_PROCESS; i++) {
+        if (process->var_names[i] < -1 || process->var_names[i] >= interned_count) {
+            return 0;
+        }
+    }
+    int lower = process->lower_memory_bound;
+    if (lower < 0) {
+        return lower == -1 && process->upper_memory_bound == -1;
+    }
+    // A resident process owns a variable region and runs inside its image's text segment
+    ProgramImage *image = &images[process->image];
+    return !process->swapped && lower <= memory_size - INPUT_SPACE_PER_PROCESS &&
+           process->upper_memory_bound == lower + INPUT_SPACE_PER_PROCESS - 1 && image->text_base >= 0 &&
+           (int)process->program_counter >= image->text_base &&
+           (int)process->program_counter <= image->text_base + image->size;
+}
 
+// Whether a restored swap slot of `length` bytes holds a well-formed variable region of a process
+int validSwapImage(const char *slot, int length, const PCB *process) {
+    const SwapHeader *header = (const SwapHeader *)slot;
+    if (header->words != INPUT_SPACE_PER_PROCESS || header->pc_offset < 0 ||
+        header->pc_offset > images[process->image].size) {
+        return 0;
+    }
+    int offset = sizeof(SwapHeader);
+    for (int i = 0; i < header->words; i++) {
+        SwapWord word;
+        if (length - offset < (int)sizeof(SwapWord)) {
+            return 0;
+        }
+        memcpy(&word, slot + offset, sizeof(SwapWord));
+        offset += sizeof(SwapWord);
+        if (word.length > MAX_VALUE_LENGTH || word.length > length - offset || word.tag > WORD_VARIABLE ||
+            word.name < -1 || word.name >= interned_count) {
+            return 0;
+        }
+        offset += word.length;
+    }
+    return offset == length;
+}
 
+// A schedule setting saved in the checkpoint, which the same option on the command line must not contradict
+int restoreSetting(enum ScheduleSetting setting, int given, int saved) {
+    if ((settings_given & (1u << setting)) && given != saved) {
+        fprintf(stderr, "Error: %s differs from the setting the checkpoint was taken with.\n", setting_options[setting]);
+        exit(EXIT_FAILURE);
+    }
+    return saved;
+}
 
+// Map a checkpoint and read the settings the rest of the startup depends on
+void openCheckpoint(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Could not open checkpoint '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    checkpoint_in.size = info.st_size;
+    checkpoint_in.offset = 0;
+    checkpoint_in.data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (checkpoint_in.data == MAP_FAILED) {
+        perror("Failed to map checkpoint");
+        exit(EXIT_FAILURE);
+    }
 
-    // Load programs into memory and queues
-    PCB *pcb1 = loadProgram(1, program1, program1size, 0, release_time1, quantum3);
-    PCB *pcb2 = loadProgram(2, program2, program2size, pcb1->upper_memory_bound + 1, release_time2, quantum3);
-    PCB *pcb3 = loadProgram(3, program3, program3size, pcb2->upper_memory_bound + 1, release_time3, quantum3);
+    CheckpointHeader *header = &checkpoint_header;
+    takeBytes(header, sizeof(CheckpointHeader));
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 || header->version != CHECKPOINT_VERSION ||
+        header->pcb_size != sizeof(PCB) || header->instruction_size != sizeof(Instruction) ||
+        header->metrics_size != sizeof(ProcessMetrics) || header->io_request_size != sizeof(IORequest) ||
+        header->policy < 0 || header->policy >= (int)(sizeof(policies) / sizeof(policies[0])) ||
+        header->core_count <= 0 || header->memory_size <= 0 || header->program_count < 0 ||
+        header->terminated_count < 0 || header->terminated_count > header->program_count || header->current_time < 0 ||
+        (header->batch_mode != 0 && header->batch_mode != 1) || header->interned_count < RESOURCE_COUNT ||
+        header->resource_count < RESOURCE_COUNT || header->resource_count > header->interned_count ||
+        (header->priority_inheritance != 0 && header->priority_inheritance != 1) ||
+        header->deadlock_recovery < RECOVER_ABORT || header->deadlock_recovery > RECOVER_ROLLBACK ||
+        header->victim_policy < VICTIM_LOWEST_PRIORITY || header->victim_policy > VICTIM_FEWEST_UNITS ||
+        header->fit_policy < FIT_FIRST || header->fit_policy > FIT_BEST ||
+        (header->swap_enabled != 0 && header->swap_enabled != 1) ||
+        (header->event_driven != 0 && header->event_driven != 1) || header->io_mode < IO_SYNC ||
+        header->io_mode > IO_ASYNC || (header->io_latency < 1 && header->io_latency != -1)) {
+        rejectCheckpoint();
+    }
+    core_count = restoreSetting(SET_CORES, core_count, header->core_count);
+    memory_size = restoreSetting(SET_MEMORY, memory_size, header->memory_size);
+    aging_interval = restoreSetting(SET_AGING, aging_interval, header->aging_interval);
+    priority_inheritance = restoreSetting(SET_INHERIT, priority_inheritance, header->priority_inheritance);
+    deadlock_recovery = restoreSetting(SET_DEADLOCK, deadlock_recovery, header->deadlock_recovery);
+    victim_policy = restoreSetting(SET_VICTIM, victim_policy, header->victim_policy);
+    fit_policy = restoreSetting(SET_FIT, fit_policy, header->fit_policy);
+    swap_enabled = restoreSetting(SET_SWAP, swap_enabled, header->swap_enabled);
+    event_driven = restoreSetting(SET_TICK, event_driven, header->event_driven);
+    io_mode = restoreSetting(SET_IO, io_mode, header->io_mode);
+    io_latency = restoreSetting(SET_IO_LATENCY, io_latency, header->io_latency);
+    batch_mode = header->batch_mode;
+    if (!policy_set) {
+        policy = &policies[header->policy];
+    }
+}
 
+// Rebuild the simulator state from the checkpoint opened by openCheckpoint, then unmap it.
+// Built-in resources and the cores must already exist.
+void restoreCheckpoint() {
+    CheckpointHeader *header = &checkpoint_header;
+    program_count = header->program_count;
+    terminated_count = header->terminated_count;
+    current_time = last_checkpoint = header->current_time;
+    mlfq_last_boost = header->mlfq_last_boost;
+    lottery_state = header->lottery_state;
+    wait_sequence = header->wait_sequence;
+    deadlock_generation = header->deadlock_generation;
+    deadlocks_detected = header->deadlocks_detected;
+    instructions_executed = header->instructions_executed;
+    dispatches = header->dispatches;
+    swap_outs = header->swap_outs;
+    swap_ins = header->swap_ins;
+    swap_bytes_out = header->swap_bytes_out;
+    swap_bytes_in = header->swap_bytes_in;
+    io_requests = header->io_requests;
+    io_wait_ticks = header->io_wait_ticks;
 
+    // Interning in the saved order gives every string its saved id
+    for (int i = 0; i < header->interned_count; i++) {
+        char *text = takeRequiredString();
+        if (internString(text) != i) {
+            rejectCheckpoint();
+        }
+        free(text);
+    }
 
-    enqueue(&started_queue, pcb1);
-    enqueue(&started_queue, pcb2);
-    enqueue(&started_queue, pcb3);
+    initMemory();
+    for (int i = 0; i < memory_size; i++) {
+        word_tag[i] = takeIntIn(WORD_EMPTY, WORD_VARIABLE);
+        word_name[i] = takeIntIn(-1, interned_count - 1);
+        char *value = takeString();
+        if (value != NULL) {
+            setWordValue(i, value);
+            free(value);
+        }
+        takeBytes(&decoded[i], sizeof(Instruction));
+        if (word_tag[i] == WORD_INSTRUCTION && !validInstruction(&decoded[i])) {
+            rejectCheckpoint();
+        }
+    }
+    // Free regions are sorted, disjoint and inside memory
+    free_region_count = takeIntIn(0, memory_size);
+    takeBytes(free_regions, free_region_count * sizeof(FreeRegion));
+    for (int i = 0; i < free_region_count; i++) {
+        int previous_end = i > 0 ? free_regions[i - 1].start + free_regions[i - 1].length : 0;
+        if (free_regions[i].start < previous_end || free_regions[i].length <= 0 ||
+            free_regions[i].length > memory_size - free_regions[i].start) {
+            rejectCheckpoint();
+        }
+    }
+    clearDirty();
 
+    // Every process runs one image, so there are never more images than processes
+    int image_total = takeIntIn(0, program_count);
+    for (int i = 0; i < image_total; i++) {
+        char *path = takeRequiredString();
+        int size = takeIntIn(0, MAX_LINES);
+        char *lines[MAX_LINES];
+        for (int j = 0; j < size; j++) {
+            lines[j] = takeRequiredString();
+        }
+        int index = addImageLines(path, lines, size);
+        for (int j = 0; j < size; j++) {
+            free(lines[j]);
+        }
+        free(path);
+        if (index != i) {
+            rejectCheckpoint();
+        }
+        ProgramImage *image = &images[index];
+        image->text_base = takeIntIn(-1, memory_size - size);
+        image->residents = takeIntIn(0, program_count);
+        if (takeIntIn(0, 1)) {
+            image->decoded = malloc((image->size + 1) * sizeof(Instruction));
+            if (image->decoded == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            takeBytes(image->decoded, image->size * sizeof(Instruction));
+            for (int j = 0; j < image->size; j++) {
+                if (!validInstruction(&image->decoded[j])) {
+                    rejectCheckpoint();
+                }
+            }
+        }
+        // A text segment is in memory exactly while some process uses it, and holds decoded instructions
+        if ((image->text_base >= 0) != (image->residents > 0) || (image->text_base >= 0 && image->decoded == NULL)) {
+            rejectCheckpoint();
+        }
+        for (int j = 0; image->text_base >= 0 && j < image->size; j++) {
+            if (word_tag[image->text_base + j] != WORD_INSTRUCTION) {
+                rejectCheckpoint();
+            }
+        }
+    }
 
+    processes = calloc(program_count, sizeof(PCB *));
+    metrics = calloc(program_count + 1, sizeof(ProcessMetrics));
+    if (processes == NULL || metrics == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    // Processes a checkpoint saw finish are absent; terminated_count covers them and the terminated ones
+    int finished = 0;
+    for (int i = 0; i < program_count; i++) {
+        if (!takeIntIn(0, 1)) {
+            finished++;
+            continue;
+        }
+        PCB *process = malloc(sizeof(PCB));
+        if (process == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        takeBytes(process, sizeof(PCB));
+        if (!validProcess(process, i + 1)) {
+            rejectCheckpoint();
+        }
+        finished += process->state == TERMINATED;
+        process->next = process->prev = NULL;
+        process->queue = NULL;
+        process->thread = NULL;
+        process->io = NULL;
+        processes[i] = process;
+    }
+    if (finished != terminated_count) {
+        rejectCheckpoint();
+    }
 
+    takeQueue(&running_queue);
+    takeQueue(&memory_wait_queue);
+    takeQueue(&io_wait_queue);
+    takeHeap(&started_queue);
+    for (int i = 0; i < core_count; i++) {
+        int current = takeIntIn(0, program_count);
+        cores[i].current = current > 0 ? processes[current - 1] : NULL;
+        if (current > 0 && cores[i].current == NULL) {
+            rejectCheckpoint();
+        }
+        cores[i].slice_left = takeInt();
+        takeBytes(&cores[i].busy_ticks, sizeof(cores[i].busy_ticks));
+        takeBytes(&cores[i].steals, sizeof(cores[i].steals));
+        takeQueue(&cores[i].ready);
+    }
 
+    for (int i = 0; i < header->resource_count; i++) {
+        int id = resourceId(internName(takeIntIn(0, interned_count - 1)));
+        if (id != i) {
+            rejectCheckpoint();
+        }
+        ResourceEntry *resource = &resources[id];
+        resource->count = takeIntIn(0, INT_MAX);
+        resource->declared = takeIntIn(0, 1);
+        sem_destroy(&resource->lock);
+        sem_init(&resource->lock, 0, takeIntIn(0, SEM_VALUE_MAX));
+        int holders = takeIntIn(0, program_count);
+        for (int j = 0; j < holders; j++) {
+            addHolder(resource, takeProcess());
+        }
+        takeHeap(&resource->waiters);
+    }
 
-    // Run the RR scheduling
-    if(quantum1<=0 || quantum2 <=0 || quantum3 <=0){
-           printf("The process can't have zero or less quantum Please Change it ");
-            cleanup();
+    for (int i = 0; i < program_count; i++) {
+        takeBytes(&metrics[i], sizeof(ProcessMetrics));
+        if (metrics[i].blocked_resources < 0 || metrics[i].blocked_resources > resource_count) {
+            rejectCheckpoint();
+        }
+        metrics[i].blocked_by_resource = malloc((metrics[i].blocked_resources + 1) * sizeof(unsigned int));
+        if (metrics[i].blocked_by_resource == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        takeBytes(metrics[i].blocked_by_resource, metrics[i].blocked_resources * sizeof(unsigned int));
+    }
 
-        return 0;
+    // Each request must point at an instruction word and hold NUL-terminated text
+    for (PCB *process = io_wait_queue.front; process != NULL; process = process->next) {
+        int index = takeIntIn(0, memory_size - 1);
+        if (word_tag[index] != WORD_INSTRUCTION) {
+            rejectCheckpoint();
+        }
+        IORequest *request = malloc(sizeof(IORequest));
+        if (request == NULL) {
+            perror("Failed to allocate memory");
+            exit(EXIT_FAILURE);
+        }
+        takeBytes(request, sizeof(IORequest));
+        if (request->opcode >= OPCODE_COUNT || memchr(request->name, '\0', sizeof(request->name)) == NULL ||
+            memchr(request->value, '\0', sizeof(request->value)) == NULL) {
+            rejectCheckpoint();
+        }
+        request->process = process;
+        request->ins = &decoded[index];
+        request->next = NULL;
+        process->io = request;
+    }
+
+    // Cached files have distinct paths, so each one adds an entry
+    int files = takeIntIn(0, INT_MAX);
+    for (int i = 0; i < files; i++) {
+        char *path = takeRequiredString();
+        int cached = vfs_count;
+        VfsFile *file = vfsOpen(path, 0);
+        if (vfs_count == cached) {
+            rejectCheckpoint();
+        }
+        int length = takeLength();
+        if (length >= 0) {
+            file->data = malloc(length + 1);
+            if (file->data == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+            takeBytes(file->data, length);
+            file->length = length;
+        }
+        file->dirty = takeIntIn(0, 1);
+        free(path);
+    }
+
+    int inputs = takeIntIn(0, INT_MAX);
+    input_next = takeIntIn(0, inputs);
+    for (int i = 0; i < inputs; i++) {
+        char *value = takeRequiredString();
+        addInput(value);
+        free(value);
+    }
+
+    // Swap records come in process id order, exactly one for each swapped process
+    int swapped = 0, records = 0;
+    for (int i = 0; i < program_count; i++) {
+        swapped += processes[i] != NULL && processes[i]->swapped;
+    }
+    initSwap();
+    for (int id = takeIntIn(0, program_count), last = 0; id > 0; last = id, id = takeIntIn(0, program_count)) {
+        int length = takeIntIn(sizeof(SwapHeader), swapImageSize(INPUT_SPACE_PER_PROCESS));
+        if (id <= last || processes[id - 1] == NULL || !processes[id - 1]->swapped) {
+            rejectCheckpoint();
+        }
+        if (swap_map == NULL && openSwap() < 0) {
+            exit(EXIT_FAILURE);
+        }
+        char *slot = swap_map + swap_offsets[id - 1];
+        takeBytes(slot, length);
+        if (!validSwapImage(slot, length, processes[id - 1])) {
+            rejectCheckpoint();
+        }
+        records++;
+    }
+    if (records != swapped || checkpoint_in.offset != checkpoint_in.size) {
+        rejectCheckpoint();
+    }
+
+    munmap(checkpoint_in.data, checkpoint_in.size);
+    TRACE(TRACE_SUMMARY, "Restored checkpoint '%s' at time %d: %d of %d processes finished\n", restore_path, current_time,
+          terminated_count, program_count);
+}
+
+#define REPLAY_MAGIC "OSMSRPLY"
+#define REPLAY_VERSION 2
+
+// Start of a replay log: the settings that shape the schedule. The workload follows (declared resources,
+// the text of each distinct program, then each process's program and parameters), then the records
+// in the order they happened.
+typedef struct ReplayHeader {
+    char magic[8];
+    unsigned int version;
+    int core_count;
+    int memory_size;
+    int policy;              // index into policies[]
+    int aging_interval;
+    int priority_inheritance;
+    unsigned int lottery_state;
+    int deadlock_recovery;
+    int victim_policy;
+    int fit_policy;
+    int swap_enabled;
+    int event_driven;
+    int io_mode;
+    int io_latency;
+    int program_count;
+    int resource_count;      // declared resources in the workload section
+    int image_count;         // distinct programs in the workload section
+} ReplayHeader;
+
+// Open the record log and write the settings and the workload to it
+void startRecording(const char *path) {
+    record_log = fopen(path, "wb");
+    if (record_log == NULL) {
+        fprintf(stderr, "Error: Could not create replay log '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(record_log, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+
+    ReplayHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.version = REPLAY_VERSION;
+    header.core_count = core_count;
+    header.memory_size = memory_size;
+    header.policy = policy - policies;
+    header.aging_interval = aging_interval;
+    header.priority_inheritance = priority_inheritance;
+    header.lottery_state = lottery_state;
+    header.deadlock_recovery = deadlock_recovery;
+    header.victim_policy = victim_policy;
+    header.fit_policy = fit_policy;
+    header.swap_enabled = swap_enabled;
+    header.event_driven = event_driven;
+    header.io_mode = io_mode;
+    header.io_latency = io_latency;
+    header.program_count = program_count;
+    header.image_count = image_count;
+    for (int i = 0; i < resource_count; i++) {
+        header.resource_count += resources[i].declared;
+    }
+    putBytes(record_log, &header, sizeof(header));
+
+    for (int i = 0; i < resource_count; i++) {
+        if (resources[i].declared) {
+            putString(record_log, internName(resources[i].name));
+            putInt(record_log, resources[i].count);
+        }
+    }
+    for (int i = 0; i < image_count; i++) {
+        putString(record_log, images[i].path);
+        putInt(record_log, images[i].size);
+        for (int j = 0; j < images[i].size; j++) {
+            putString(record_log, images[i].lines[j]);
+        }
+    }
+    for (int i = 0; i < program_count; i++) {
+        WorkloadEntry *entry = &workload[i];
+        putInt(record_log, entry->image);
+        putInt(record_log, entry->release_time);
+        putInt(record_log, entry->quantum);
+        putInt(record_log, entry->priority);
+    }
+}
+
+// A copy of a string stored in the replay log
+char *takeReplayString() {
+    int length;
+    takeReplay(&length, sizeof(length));
+    if (length < 0 || (size_t)length > replay_size - replay_offset) {
+        replayDiverged("a corrupt workload", "a workload");
+    }
+    char *text = malloc(length + 1);
+    if (text == NULL) {
+        perror("Failed to allocate memory");
+        exit(EXIT_FAILURE);
+    }
+    takeReplay(text, length);
+    text[length] = '\0';
+    return text;
+}
+
+// Map a replay log and apply the settings it was recorded with
+void openReplay(const char *path) {
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Error: Could not open replay log '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    replay_size = info.st_size;
+    replay_data = replay_size > 0 ? mmap(NULL, replay_size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    ReplayHeader header;
+    if (replay_data == MAP_FAILED || replay_size < sizeof(header)) {
+        fprintf(stderr, "Error: '%s' is not a replay log.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(&header, replay_data, sizeof(header));
+    replay_offset = sizeof(header);
+    if (memcmp(header.magic, REPLAY_MAGIC, sizeof(header.magic)) != 0 || header.version != REPLAY_VERSION ||
+        header.policy < 0 || header.policy >= (int)(sizeof(policies) / sizeof(policies[0]))) {
+        fprintf(stderr, "Error: '%s' is not a replay log written by this version of the simulator.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    replaying = 1;
+    batch_mode = 1;
+    core_count = header.core_count;
+    memory_size = header.memory_size;
+    policy = &policies[header.policy];
+    aging_interval = header.aging_interval;
+    priority_inheritance = header.priority_inheritance;
+    lottery_state = header.lottery_state;
+    deadlock_recovery = header.deadlock_recovery;
+    victim_policy = header.victim_policy;
+    fit_policy = header.fit_policy;
+    swap_enabled = header.swap_enabled;
+    event_driven = header.event_driven;
+    io_mode = header.io_mode;
+    io_latency = header.io_latency;
+    fs_preload = 0;
+    if (!pacing_set) {
+        pacing_mode = PACE_MAX;
+    }
+}
+
+// Declare the resources and add the programs stored in the replay log
+void loadReplayWorkload() {
+    ReplayHeader *header = (ReplayHeader *)replay_data;
+    for (int i = 0; i < header->resource_count; i++) {
+        char *name = takeReplayString();
+        int count;
+        takeReplay(&count, sizeof(count));
+        declareResource(name, count);
+        free(name);
+    }
+    for (int i = 0; i < header->image_count; i++) {
+        char *path = takeReplayString();
+        int size;
+        takeReplay(&size, sizeof(size));
+        if (size < 0 || size > MAX_LINES) {
+            replayDiverged("a corrupt workload", "a workload");
+        }
+        char *lines[MAX_LINES];
+        for (int j = 0; j < size; j++) {
+            lines[j] = takeReplayString();
+        }
+        if (addImageLines(path, lines, size) != i) {
+            replayDiverged("a corrupt workload", "a workload");
+        }
+        for (int j = 0; j < size; j++) {
+            free(lines[j]);
+        }
+        free(path);
+    }
+    for (int i = 0; i < header->program_count; i++) {
+        int fields[4];
+        takeReplay(fields, sizeof(fields));
+        if (fields[0] < 0 || fields[0] >= image_count) {
+            replayDiverged("a corrupt workload", "a workload");
+        }
+        if (program_count == workload_capacity) {
+            workload_capacity = workload_capacity == 0 ? 16 : workload_capacity * 2;
+            workload = realloc(workload, workload_capacity * sizeof(WorkloadEntry));
+            if (workload == NULL) {
+                perror("Failed to allocate memory");
+                exit(EXIT_FAILURE);
+            }
+        }
+        WorkloadEntry *entry = &workload[program_count++];
+        entry->image = fields[0];
+        entry->release_time = fields[1];
+        entry->quantum = fields[2];
+        entry->priority = fields[3];
+    }
+}
+
+// Close the record log, or make sure the replayed run made every logged decision
+void finishReplay() {
+    if (record_log != NULL) {
+        int failed = ferror(record_log);
+        if (fclose(record_log) != 0 || failed) {
+            fprintf(stderr, "Error: Could not write replay log '%s'.\n", record_path);
+        }
+        record_log = NULL;
+        TRACE(TRACE_SUMMARY, "Recorded %lu decisions and %lu external values to %s\n", replay_decisions, replay_values, record_path);
+    } else if (replaying) {
+        if (replay_offset != replay_size) {
+            replayDiverged("more records", "none");
+        }
+        munmap(replay_data, replay_size);
+        TRACE(TRACE_SUMMARY, "Replay verified: %lu decisions and %lu external values matched %s\n", replay_decisions, replay_values,
+              replay_path);
+    }
+}
+
+const char *manifest_path = NULL;
+const char *inputs_path = NULL;
+
+// Parse command line options
+void parseArguments(int argc, char *argv[]) {
+    policy = &policies[0];
+    program_output = stdout;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tick") == 0) {
+            event_driven = 0;
+            settings_given |= 1u << SET_TICK;
+        } else if (strcmp(argv[i], "--pace=max") == 0) {
+            pacing_mode = PACE_MAX;
+            pacing_set = 1;
+        } else if (strcmp(argv[i], "--pace=demo") == 0) {
+            pacing_mode = PACE_DEMO;
+            pacing_set = 1;
+        } else if (strncmp(argv[i], "--pace=scaled:", 14) == 0) {
+            pacing_mode = PACE_SCALED;
+            pacing_set = 1;
+            tick_length_us = atol(argv[i] + 14);
+            if (tick_length_us <= 0) {
+                fprintf(stderr, "Tick length must be a positive number of microseconds\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--manifest=", 11) == 0) {
+            manifest_path = argv[i] + 11;
+        } else if (strncmp(argv[i], "--inputs=", 9) == 0) {
+            inputs_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--quantum=", 10) == 0) {
+            default_quantum = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--memory=", 9) == 0) {
+            memory_size = atoi(argv[i] + 9);
+            settings_given |= 1u << SET_MEMORY;
+            if (memory_size <= 0) {
+                fprintf(stderr, "Memory size must be a positive number of words\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "--fit=first") == 0) {
+            fit_policy = FIT_FIRST;
+            settings_given |= 1u << SET_FIT;
+        } else if (strcmp(argv[i], "--fit=best") == 0) {
+            fit_policy = FIT_BEST;
+            settings_given |= 1u << SET_FIT;
+        } else if (strcmp(argv[i], "--trace=silent") == 0) {
+            trace_level = TRACE_SILENT;
+        } else if (strcmp(argv[i], "--trace=summary") == 0) {
+            trace_level = TRACE_SUMMARY;
+        } else if (strcmp(argv[i], "--trace=event") == 0) {
+            trace_level = TRACE_EVENT;
+        } else if (strcmp(argv[i], "--trace=full") == 0) {
+            trace_level = TRACE_FULL;
+        } else if (strncmp(argv[i], "--cores=", 8) == 0) {
+            core_count = atoi(argv[i] + 8);
+            settings_given |= 1u << SET_CORES;
+            if (core_count <= 0) {
+                fprintf(stderr, "Core count must be positive\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--policy=", 9) == 0) {
+            policy = NULL;
+            policy_set = 1;
+            for (size_t j = 0; j < sizeof(policies) / sizeof(policies[0]); j++) {
+                if (strcmp(argv[i] + 9, policies[j].name) == 0) {
+                    policy = &policies[j];
+                }
+            }
+            if (policy == NULL) {
+                fprintf(stderr, "Unknown scheduling policy '%s'\n", argv[i] + 9);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--aging=", 8) == 0) {
+            aging_interval = atoi(argv[i] + 8);
+            settings_given |= 1u << SET_AGING;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            lottery_state = strtoul(argv[i] + 7, NULL, 10);
+            if (lottery_state == 0) {
+                lottery_state = 1;
+            }
+        } else if (strcmp(argv[i], "--deadlock=abort") == 0) {
+            deadlock_recovery = RECOVER_ABORT;
+            settings_given |= 1u << SET_DEADLOCK;
+        } else if (strcmp(argv[i], "--deadlock=kill") == 0) {
+            deadlock_recovery = RECOVER_KILL;
+            settings_given |= 1u << SET_DEADLOCK;
+        } else if (strcmp(argv[i], "--deadlock=rollback") == 0) {
+            deadlock_recovery = RECOVER_ROLLBACK;
+            settings_given |= 1u << SET_DEADLOCK;
+        } else if (strcmp(argv[i], "--victim=lowest-priority") == 0) {
+            victim_policy = VICTIM_LOWEST_PRIORITY;
+            settings_given |= 1u << SET_VICTIM;
+        } else if (strcmp(argv[i], "--victim=youngest") == 0) {
+            victim_policy = VICTIM_YOUNGEST;
+            settings_given |= 1u << SET_VICTIM;
+        } else if (strcmp(argv[i], "--victim=fewest-units") == 0) {
+            victim_policy = VICTIM_FEWEST_UNITS;
+            settings_given |= 1u << SET_VICTIM;
+        } else if (strcmp(argv[i], "--inherit") == 0) {
+            priority_inheritance = 1;
+            settings_given |= 1u << SET_INHERIT;
+        } else if (strncmp(argv[i], "--program-output=", 17) == 0) {
+            program_output = fopen(argv[i] + 17, "w");
+            if (program_output == NULL) {
+                fprintf(stderr, "Error: Could not open '%s' for program output.\n", argv[i] + 17);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--metrics-csv=", 14) == 0) {
+            metrics_csv_path = argv[i] + 14;
+        } else if (strncmp(argv[i], "--metrics-json=", 15) == 0) {
+            metrics_json_path = argv[i] + 15;
+        } else if (strcmp(argv[i], "--fs=cached") == 0) {
+            fs_mode = FS_CACHED;
+        } else if (strcmp(argv[i], "--fs=sync") == 0) {
+            fs_mode = FS_SYNC;
+        } else if (strncmp(argv[i], "--fs-writeback=", 15) == 0) {
+            fs_writeback_interval = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--fs-root=", 10) == 0) {
+            fs_root = argv[i] + 10;
+        } else if (strcmp(argv[i], "--fs-preload") == 0) {
+            fs_preload = 1;
+        } else if (strcmp(argv[i], "--io=sync") == 0) {
+            io_mode = IO_SYNC;
+            settings_given |= 1u << SET_IO;
+        } else if (strcmp(argv[i], "--io=async") == 0) {
+            io_mode = IO_ASYNC;
+            settings_given |= 1u << SET_IO;
+        } else if (strcmp(argv[i], "--io-latency=real") == 0) {
+            io_latency = -1;
+            settings_given |= 1u << SET_IO_LATENCY;
+        } else if (strncmp(argv[i], "--io-latency=", 13) == 0) {
+            io_latency = atoi(argv[i] + 13);
+            settings_given |= 1u << SET_IO_LATENCY;
+            if (io_latency < 1) {
+                fprintf(stderr, "Error: --io-latency needs at least one tick, or 'real'.\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--io-workers=", 13) == 0) {
+            io_worker_count = atoi(argv[i] + 13);
+            if (io_worker_count < 1) {
+                fprintf(stderr, "Error: --io-workers needs at least one worker.\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            checkpoint_path = argv[i] + 13;
+        } else if (strncmp(argv[i], "--checkpoint-every=", 19) == 0) {
+            checkpoint_interval = atoi(argv[i] + 19);
+        } else if (strncmp(argv[i], "--restore=", 10) == 0) {
+            restore_path = argv[i] + 10;
+        } else if (strncmp(argv[i], "--record=", 9) == 0) {
+            record_path = argv[i] + 9;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay_path = argv[i] + 9;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench_report = 1;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threaded = 1;
+        } else if (strcmp(argv[i], "--no-swap") == 0) {
+            swap_enabled = 0;
+            settings_given |= 1u << SET_SWAP;
+        } else if (strncmp(argv[i], "--swap-file=", 12) == 0) {
+            swap_path = argv[i] + 12;
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    parseArguments(argc, argv);
+    setvbuf(stdout, NULL, _IOFBF, TRACE_BUFFER_SIZE);
+    if (restore_path != NULL && (record_path != NULL || replay_path != NULL)) {
+        fprintf(stderr, "Error: --record and --replay start from the beginning and cannot be combined with --restore.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (record_path != NULL && replay_path != NULL) {
+        fprintf(stderr, "Error: --record and --replay cannot be combined.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (restore_path != NULL) {
+        openCheckpoint(restore_path);
+    }
+    if (replay_path != NULL) {
+        openReplay(replay_path);
+    }
+
+    // SIGUSR1 asks for a checkpoint at the next tick boundary
+    struct sigaction on_checkpoint;
+    memset(&on_checkpoint, 0, sizeof(on_checkpoint));
+    on_checkpoint.sa_handler = requestCheckpoint;
+    on_checkpoint.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &on_checkpoint, NULL);
+
+    sem_init(&file_mutex, 0, 1);
+    sem_init(&input_mutex, 0, 1);
+    sem_init(&output_mutex, 0, 1);
+    for (int i = 0; i < RESOURCE_COUNT; i++) {
+        resourceId(resource_names[i]);
+    }
+
+    initQueue(&running_queue);
+
+    cores = calloc(core_count, sizeof(Core));
+    for (int i = 0; i < core_count; i++) {
+        cores[i].id = i;
+        initQueue(&cores[i].ready);
+    }
+    initQueue(&memory_wait_queue);
+    initQueue(&io_wait_queue);
+    initHeap(&started_queue, releasesBefore);
+
+
+    if (restore_path != NULL) {
+        // Resume a checkpointed run; the workload and inputs come from the checkpoint
+        restoreCheckpoint();
+        if (batch_mode && !pacing_set) {
+            pacing_mode = PACE_MAX;
+        }
+    } else {
+        if (inputs_path != NULL && !replaying) {
+            loadInputs(inputs_path);
+        }
+
+        if (replay_path != NULL) {
+            // Replay: the workload comes from the log, the terminal and the files are never touched
+            loadReplayWorkload();
+        } else if (manifest_path != NULL) {
+            // Batch mode: everything comes from the manifest and the flags
+            batch_mode = 1;
+            if (!pacing_set) {
+                pacing_mode = PACE_MAX;
+            }
+            loadManifest(manifest_path);
+        } else {
+            // User inputs for release times and quantum times
+            int release_times[INTERACTIVE_PROGRAMS];
+            unsigned int quantum;
+            for (int i = 0; i < INTERACTIVE_PROGRAMS; i++) {
+                printf("Enter release time for program %d: ", i + 1);
+                fflush(stdout);
+                scanf("%d", &release_times[i]);
+            }
+            printf("Enter quantum time for The OS : ");
+            fflush(stdout);
+            scanf("%u", &quantum);
+
+            for (int i = 0; i < INTERACTIVE_PROGRAMS; i++) {
+                char path[20];
+                sprintf(path, "Program_%d.txt", i + 1);
+                addWorkload(path, release_times[i], quantum, 0);
+            }
+        }
+        if (record_path != NULL) {
+            startRecording(record_path);
+        }
+
+        // Create the processes; each is loaded into memory when it is released
+        initMemory();
+        processes = calloc(program_count, sizeof(PCB *));
+        metrics = calloc(program_count + 1, sizeof(ProcessMetrics));
+        for (int i = 0; i < program_count; i++) {
+            WorkloadEntry *entry = &workload[i];
+            if (entry->quantum <= 0) {
+                printf("The process can't have zero or less quantum Please Change it ");
+                cleanup();
+                return 0;
+            }
+            if (images[entry->image].size + INPUT_SPACE_PER_PROCESS > memory_size) {
+                fprintf(stderr, "Error: program %d does not fit in %d words of memory.\n", i + 1, memory_size);
+                cleanup();
+                return EXIT_FAILURE;
+            }
+            processes[i] = createProcess(i + 1, entry->image, entry->release_time, entry->quantum, entry->priority);
+            metrics[i].arrival = entry->release_time;
+            metrics[i].first_run = metrics[i].completion = -1;
+            pushHeap(&started_queue, processes[i]);
+        }
+        initSwap();
+    }
+    if (fs_mode == FS_CACHED) {
+        // Dirty files reach the host however the run ends
+        atexit(vfsWriteBack);
+        if (fs_preload) {
+            vfsPreload();
+        }
+    }
+
+    // Run the processes under the selected scheduling policy
+    struct timespec run_start;
+    clock_gettime(CLOCK_MONOTONIC, &run_start);
+    int end_time = schedule();
+    double wall_seconds = elapsedNs(&run_start) / 1e9;
+    TRACE(TRACE_SUMMARY, "Simulation finished: %d processes, %lu instructions executed\n", program_count, instructions_executed);
+    finishReplay();
+    vfsWriteBack();
+    printCoreUtilization(end_time);
+    printMetricsSummary(end_time);
+    if (io_requests > 0) {
+        TRACE(TRACE_SUMMARY, "I/O: %lu asynchronous requests, average wait %.2f ticks, scheduler stalled %.3f ms on workers\n",
+              io_requests, (double)io_wait_ticks / io_requests, io_stall_ns / 1e6);
+    }
+    if (vfs_reads + vfs_writes > 0) {
+        TRACE(TRACE_SUMMARY, "Files: %lu reads and %lu writes cached, %lu host reads, %lu files written back\n", vfs_reads,
+              vfs_writes, vfs_host_reads, vfs_write_backs);
+    }
+    if (metrics_csv_path != NULL) {
+        writeMetricsCsv(metrics_csv_path);
+    }
+    if (metrics_json_path != NULL) {
+        writeMetricsJson(metrics_json_path, end_time);
+    }
+    if (bench_report) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        printf("Bench: %d processes, %lu instructions, %d ticks in %.3f s wall (%.0f instructions/s)\n", program_count,
+               instructions_executed, end_time, wall_seconds, wall_seconds > 0 ? instructions_executed / wall_seconds : 0.0);
+        printf("Bench: peak RSS %ld KiB, %lu context switches, %.0f ns scheduling overhead per switch\n", usage.ru_maxrss,
+               dispatches, dispatches > 0 ? (double)scheduling_ns / dispatches : 0.0);
+        fflush(stdout);
+    }
+    if (deadlocks_detected > 0) {
+        TRACE(TRACE_SUMMARY, "Deadlocks: %lu detected and broken\n", deadlocks_detected);
+    }
+    if (threaded && handoffs > 0) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        TRACE(TRACE_SUMMARY, "Threads: %lu handoffs, average handoff %.1f us, %lu contended I/O sections waiting %.1f us in total\n",
+              handoffs, handoff_ns / 1000.0 / handoffs, contended_io, io_wait_ns / 1000.0);
+        TRACE(TRACE_SUMMARY, "Context switches: %ld voluntary, %ld involuntary\n", usage.ru_nvcsw, usage.ru_nivcsw);
+    }
+    if (checkpoints_written > 0) {
+        TRACE(TRACE_SUMMARY, "Checkpoints: %lu written to %s\n", checkpoints_written, checkpoint_path);
+    }
+    if (swap_outs > 0) {
+        TRACE(TRACE_SUMMARY, "Swap: %lu swap-outs, %lu swap-ins, %llu bytes out, %llu bytes in\n", swap_outs, swap_ins, swap_bytes_out, swap_bytes_in);
     }
-    rr_scheduling();
 
     // Cleanup resources
     cleanup();
+    free(workload);
 
     return 0;
 }
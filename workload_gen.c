@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+
+// Generates synthetic workloads for OSms2: one program file per process plus a
+// manifest (see "Batch Mode" in the README) that releases them.
+
+#define MAX_PROGRAM_LINES 100 // the simulator reads at most 100 lines per program
+#define DATA_FILES 8          // files the programs read and write, shared to create contention
+#define POOL_UNITS 4          // units of each generated pool resource
+
+// How release times are spread
+enum Arrival {
+    ARRIVAL_POISSON, // exponential gaps with mean 1 / rate ticks
+    ARRIVAL_BURSTY,  // burst_size programs at once, burst_gap ticks apart
+    ARRIVAL_UNIFORM  // one program every uniform_gap ticks
+};
+
+// Kinds of instruction in the mix
+enum InstructionKind {
+    KIND_COMPUTE, // assign var value
+    KIND_PRINT,   // print / printFromTo
+    KIND_FILE,    // writeFile / readFile / assign var readFile
+    KIND_INPUT,   // assign var input
+    KIND_COUNT
+};
+
+const char *kind_names[KIND_COUNT] = {"compute", "print", "file", "input"};
+// Built-in resource whose mutex an instruction of each kind needs
+const char *kind_resources[KIND_COUNT] = {NULL, "userOutput", "file", "userInput"};
+
+// Generator settings
+int program_count = 1000;
+int min_length = 5;
+int max_length = 20;
+int mix[KIND_COUNT] = {50, 25, 15, 10};
+double contention = 0.5; // chance that an instruction runs inside a critical section
+int pool_count = 2;      // extra counting-semaphore resources, pool0 .. poolN-1
+enum Arrival arrival = ARRIVAL_POISSON;
+double arrival_rate = 0.5;
+int burst_size = 50;
+int burst_gap = 100;
+int uniform_gap = 2;
+int max_priority = 10;
+const char *out_dir = "workload";
+unsigned long long rng_state = 88172645463325252ULL;
+
+// Next pseudo-random number (xorshift64), reproducible for a given --seed
+unsigned long long nextRandom() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Uniform random number in [0, 1)
+double randomUnit() {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Uniform random integer in [low, high]
+int randomBetween(int low, int high) {
+    return low + (int)(nextRandom() % (unsigned long long)(high - low + 1));
+}
+
+// Pick an instruction kind with probability proportional to its share of the mix
+enum InstructionKind randomKind() {
+    int total = 0;
+    for (int i = 0; i < KIND_COUNT; i++) {
+        total += mix[i];
+    }
+    int pick = randomBetween(0, total - 1);
+    for (int i = 0; i < KIND_COUNT; i++) {
+        if (pick < mix[i]) {
+            return i;
+        }
+        pick -= mix[i];
+    }
+    return KIND_COMPUTE;
+}
+
+// Release time of the next program, given the previous one's
+int nextRelease(int index, int previous) {
+    switch (arrival) {
+        case ARRIVAL_POISSON:
+            return index == 0 ? 0 : previous + (int)floor(-log(1.0 - randomUnit()) / arrival_rate);
+        case ARRIVAL_BURSTY:
+            return (index / burst_size) * burst_gap;
+        case ARRIVAL_UNIFORM:
+            return index * uniform_gap;
+    }
+    return 0;
+}
+
+// Write one instruction of the given kind; returns the number of input values it consumes
+int writeInstruction(FILE *out, enum InstructionKind kind) {
+    const char *vars = "abc";
+    char var = vars[randomBetween(0, 2)];
+    int file = randomBetween(0, DATA_FILES - 1);
+    switch (kind) {
+        case KIND_COMPUTE:
+            fprintf(out, "assign %c %d\n", var, randomBetween(0, 999));
+            return 0;
+        case KIND_PRINT:
+            if (randomBetween(0, 3) == 0) {
+                int start = randomBetween(0, 20);
+                fprintf(out, "printFromTo %d %d\n", start, start + randomBetween(0, 4));
+            } else {
+                fprintf(out, "print %c\n", var);
+            }
+            return 0;
+        case KIND_FILE:
+            switch (randomBetween(0, 2)) {
+                case 0:
+                    fprintf(out, "writeFile bench_%d.dat %c\n", file, var);
+                    break;
+                case 1:
+                    fprintf(out, "readFile bench_%d.dat %c\n", file, var);
+                    break;
+                default:
+                    fprintf(out, "assign %c readFile bench_%d.dat\n", var, file);
+                    break;
+            }
+            return 0;
+        case KIND_INPUT:
+            fprintf(out, "assign %c input\n", var);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Write one program; returns the number of input values it consumes
+int writeProgram(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Error: Could not create '%s'.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    // Bind all three variables first so prints and writes always have a value
+    fprintf(out, "assign a 1\nassign b 2\nassign c 3\n");
+    int length = randomBetween(min_length, max_length);
+    int inputs = 0;
+    for (int i = 0; i < length; i++) {
+        enum InstructionKind kind = randomKind();
+        const char *resource = kind_resources[kind];
+        if (randomUnit() < contention && pool_count > 0 && (resource == NULL || randomBetween(0, 3) == 0)) {
+            // Only one resource is held at a time, so generated workloads cannot deadlock
+            int pool = randomBetween(0, pool_count - 1);
+            fprintf(out, "semWait pool%d\n", pool);
+            inputs += writeInstruction(out, kind);
+            fprintf(out, "semSignal pool%d\n", pool);
+        } else if (resource != NULL && randomUnit() < contention) {
+            fprintf(out, "semWait %s\n", resource);
+            inputs += writeInstruction(out, kind);
+            fprintf(out, "semSignal %s\n", resource);
+        } else {
+            inputs += writeInstruction(out, kind);
+        }
+    }
+    fclose(out);
+    return inputs;
+}
+
+// Parse a mix such as compute:50,print:25,file:15,input:10
+void parseMix(const char *text) {
+    memset(mix, 0, sizeof(mix));
+    char copy[256];
+    snprintf(copy, sizeof(copy), "%s", text);
+    for (char *part = strtok(copy, ","); part != NULL; part = strtok(NULL, ",")) {
+        char name[20];
+        int share;
+        int known = 0;
+        if (sscanf(part, "%19[^:]:%d", name, &share) == 2) {
+            for (int i = 0; i < KIND_COUNT; i++) {
+                if (strcmp(name, kind_names[i]) == 0) {
+                    mix[i] = share;
+                    known = 1;
+                }
+            }
+        }
+        if (!known || share < 0) {
+            fprintf(stderr, "Bad mix entry '%s'\n", part);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (mix[KIND_COMPUTE] + mix[KIND_PRINT] + mix[KIND_FILE] + mix[KIND_INPUT] == 0) {
+        fprintf(stderr, "The mix needs at least one instruction kind\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Parse command line options
+void parseArguments(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--programs=", 11) == 0) {
+            program_count = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--length=", 9) == 0) {
+            if (sscanf(argv[i] + 9, "%d:%d", &min_length, &max_length) != 2) {
+                min_length = max_length = atoi(argv[i] + 9);
+            }
+        } else if (strncmp(argv[i], "--mix=", 6) == 0) {
+            parseMix(argv[i] + 6);
+        } else if (strncmp(argv[i], "--contention=", 13) == 0) {
+            contention = atof(argv[i] + 13);
+        } else if (strncmp(argv[i], "--pools=", 8) == 0) {
+            pool_count = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--arrival=poisson:", 18) == 0) {
+            arrival = ARRIVAL_POISSON;
+            arrival_rate = atof(argv[i] + 18);
+        } else if (strncmp(argv[i], "--arrival=bursty:", 17) == 0) {
+            arrival = ARRIVAL_BURSTY;
+            if (sscanf(argv[i] + 17, "%d:%d", &burst_size, &burst_gap) != 2) {
+                fprintf(stderr, "Usage: --arrival=bursty:SIZE:GAP\n");
+                exit(EXIT_FAILURE);
+            }
+        } else if (strncmp(argv[i], "--arrival=uniform:", 18) == 0) {
+            arrival = ARRIVAL_UNIFORM;
+            uniform_gap = atoi(argv[i] + 18);
+        } else if (strncmp(argv[i], "--priorities=", 13) == 0) {
+            max_priority = atoi(argv[i] + 13);
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            rng_state = strtoull(argv[i] + 7, NULL, 10) * 2685821657736338717ULL + 1;
+        } else if (strncmp(argv[i], "--out=", 6) == 0) {
+            out_dir = argv[i] + 6;
+        } else {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (program_count <= 0 || min_length < 0 || max_length < min_length || 3 + 3 * max_length > MAX_PROGRAM_LINES ||
+        max_priority <= 0 || (arrival == ARRIVAL_POISSON && arrival_rate <= 0) || (arrival == ARRIVAL_BURSTY && (burst_size <= 0 || burst_gap < 0))) {
+        fprintf(stderr, "Invalid workload settings\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    parseArguments(argc, argv);
+    mkdir(out_dir, 0755);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/manifest.txt", out_dir);
+    FILE *manifest = fopen(path, "w");
+    if (manifest == NULL) {
+        fprintf(stderr, "Error: Could not create '%s'.\n", path);
+        return EXIT_FAILURE;
+    }
+    fprintf(manifest, "# Generated by workload_gen: %d programs\n", program_count);
+    for (int i = 0; i < pool_count; i++) {
+        fprintf(manifest, "resource pool%d %d\n", i, POOL_UNITS);
+    }
+
+    // The data files the programs read, so every read finds something
+    for (int i = 0; i < DATA_FILES; i++) {
+        snprintf(path, sizeof(path), "%s/bench_%d.dat", out_dir, i);
+        FILE *data = fopen(path, "w");
+        if (data != NULL) {
+            fprintf(data, "%d\n", i);
+            fclose(data);
+        }
+    }
+
+    int release = 0;
+    long inputs = 0;
+    for (int i = 0; i < program_count; i++) {
+        snprintf(path, sizeof(path), "%s/prog_%d.txt", out_dir, i);
+        inputs += writeProgram(path);
+        release = nextRelease(i, release);
+        fprintf(manifest, "program prog_%d.txt %d 2 %d\n", i, release, randomBetween(0, max_priority - 1));
+    }
+    for (long i = 0; i < inputs; i++) {
+        fprintf(manifest, "input %ld\n", i);
+    }
+    fclose(manifest);
+    printf("Wrote %d programs (%ld input values) to %s\n", program_count, inputs, out_dir);
+    return 0;
+}